@@ -0,0 +1,331 @@
+#pragma once
+
+#include <spdlog/sinks/base_sink.h>
+#include <spdlog/details/file_helper.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <tuple>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <algorithm>
+#include <cstdio>
+#include <ctime>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+
+// 定义为 0 时不依赖 zlib (不需要 -lz)，归档文件保持不压缩
+#ifndef LOGGER_ZLIB
+#define LOGGER_ZLIB 1
+#endif
+
+#if LOGGER_ZLIB
+#include <zlib.h>
+#endif
+
+namespace utils {
+
+    namespace log {
+
+        struct archive_policy
+        {
+            bool compress = true;                   // 压缩为 .gz
+            int level = 6;                          // zlib 压缩级别 1-9
+            std::size_t max_total_size = 0;         // 归档文件总大小上限 (字节)，0 为不限
+            std::chrono::seconds max_age{ 0 };      // 归档文件最长保留时间，0 为不限
+        };
+
+        // 日志归档: 写满的文件改名为 app.20261018-012345.log，由后台线程压缩为 .gz，再按总大小和保留时间删除最旧的归档
+        // 调用者只做一次 rename，压缩和删除都在后台以最低优先级进行
+        // 启动时会补压上次退出前没来得及压缩的文件，并按策略清理一次
+        class archiver
+        {
+            struct entry {
+                std::string path;
+                std::int64_t mtime;             // 纳秒，同一秒内切换的文件也能分出先后
+                std::int64_t size;
+            };
+
+        public:
+            archiver(std::string filename, archive_policy policy)
+                : _base(std::move(filename)), _policy(policy) {
+                std::tie(_stem, _ext) = spdlog::details::file_helper::split_by_extension(_base);
+                std::size_t slash = _stem.rfind('/');
+                _dir = slash == std::string::npos ? "./" : _stem.substr(0, slash + 1);
+                _prefix = (slash == std::string::npos ? _stem : _stem.substr(slash + 1)) + ".";
+                for (auto &e : scan())
+                    if (!ends_with(e.path, ".gz"))
+                        _queue.push_back(e.path);
+                _worker = std::thread(&archiver::background, this);
+            }
+
+            // 处理完队列中的文件再退出
+            ~archiver() {
+                {
+                    std::lock_guard<std::mutex> lock{ _lock };
+                    _run = false;
+                }
+                _cv.notify_one();
+                if (_worker.joinable())
+                    _worker.join();
+            }
+
+            archiver(const archiver&) = delete;
+            archiver& operator=(const archiver&) = delete;
+
+            // 把已关闭的当前文件改名为归档文件名并交给后台，调用者保证此时没有人在写它
+            void retire() {
+                std::string name = next_name();
+                if (std::rename(_base.c_str(), name.c_str()) != 0)
+                    return;
+                {
+                    std::lock_guard<std::mutex> lock{ _lock };
+                    _queue.push_back(std::move(name));
+                }
+                _cv.notify_one();
+            }
+
+            // 等待已交给后台的文件处理完
+            void wait_idle() {
+                std::unique_lock<std::mutex> lock{ _lock };
+                _idle_cv.wait(lock, [this] { return _queue.empty() && !_busy; });
+            }
+
+            const archive_policy& policy() const { return _policy; }
+
+        private:
+            static bool ends_with(const std::string &s, const char *suffix) {
+                std::size_t n = std::char_traits<char>::length(suffix);
+                return s.size() >= n && s.compare(s.size() - n, n, suffix) == 0;
+            }
+
+            // app.20261018-012345.log，同一秒内多次切换时为 app.20261018-012345-1.log ...
+            std::string next_name() {
+                std::time_t now = std::time(nullptr);
+                std::tm local;
+                ::localtime_r(&now, &local);
+                char stamp[32];
+                std::strftime(stamp, sizeof(stamp), "%Y%m%d-%H%M%S", &local);
+                std::string name = _stem + "." + stamp + _ext;
+                for (int i = 1; ::access(name.c_str(), F_OK) == 0 || ::access((name + ".gz").c_str(), F_OK) == 0; ++i)
+                    name = _stem + "." + stamp + "-" + std::to_string(i) + _ext;
+                return name;
+            }
+
+            // 文件名中间部分是否为 next_name 生成的时间戳，避免误删 app.1.log 之类的文件
+            static bool is_stamp(const std::string &s) {
+                if (s.size() < 15 || s[8] != '-')
+                    return false;
+                for (std::size_t i = 0; i < s.size(); ++i) {
+                    if (i == 8 || (i == 15 && s[i] == '-' && s.size() > 16))
+                        continue;
+                    if (s[i] < '0' || s[i] > '9')
+                        return false;
+                }
+                return true;
+            }
+
+            // 列出目录中属于这个日志的归档文件，从旧到新；顺带删除压缩到一半留下的临时文件
+            std::vector<entry> scan() {
+                std::vector<entry> found;
+                DIR *dir = ::opendir(_dir.c_str());
+                if (!dir)
+                    return found;
+                while (struct dirent *d = ::readdir(dir)) {
+                    std::string name = d->d_name;
+                    if (name.compare(0, _prefix.size(), _prefix) != 0)
+                        continue;
+                    std::string rest = name.substr(_prefix.size());
+                    bool tmp = ends_with(rest, ".gz.tmp");
+                    if (tmp)
+                        rest.resize(rest.size() - 4);
+                    if (ends_with(rest, ".gz"))
+                        rest.resize(rest.size() - 3);
+                    if (!ends_with(rest, _ext.c_str()) || !is_stamp(rest.substr(0, rest.size() - _ext.size())))
+                        continue;
+                    std::string path = _dir + name;
+                    if (tmp) {
+                        ::unlink(path.c_str());
+                        continue;
+                    }
+                    struct stat st;
+                    if (::stat(path.c_str(), &st) == 0)
+                        found.push_back(entry{ path, st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec, static_cast<std::int64_t>(st.st_size) });
+                }
+                ::closedir(dir);
+                std::sort(found.begin(), found.end(), [](const entry &a, const entry &b) {
+                    return a.mtime != b.mtime ? a.mtime < b.mtime : a.path < b.path;
+                });
+                return found;
+            }
+
+            // 压缩为 path.gz 后删除原文件；先写临时文件再改名，中途退出不会留下不完整的 .gz
+            // 失败时保留原文件，仍然参与保留策略
+            bool compress(const std::string &path) {
+#if LOGGER_ZLIB
+                int in = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+                if (in < 0)
+                    return false;
+                struct stat st;
+                ::fstat(in, &st);
+                std::string tmp = path + ".gz.tmp";
+                char mode[8];
+                std::snprintf(mode, sizeof(mode), "wb%d", std::min(9, std::max(1, _policy.level)));
+                gzFile out = ::gzopen(tmp.c_str(), mode);
+                bool ok = out != nullptr;
+                std::vector<char> buf(ok ? 256 * 1024 : 0);
+                while (ok) {
+                    ssize_t n = ::read(in, buf.data(), buf.size());
+                    if (n < 0 && errno == EINTR)
+                        continue;
+                    if (n <= 0) {
+                        ok = n == 0;
+                        break;
+                    }
+                    ok = ::gzwrite(out, buf.data(), static_cast<unsigned>(n)) == n;
+                }
+                ::close(in);
+                if (out && ::gzclose(out) != Z_OK)
+                    ok = false;
+                if (ok) {
+                    // 保留原文件的修改时间，保留策略按日志最后写入的时间计算
+                    struct timespec times[2] = { st.st_atim, st.st_mtim };
+                    ::utimensat(AT_FDCWD, tmp.c_str(), times, 0);
+                    ok = std::rename(tmp.c_str(), (path + ".gz").c_str()) == 0;
+                }
+                if (!ok) {
+                    ::unlink(tmp.c_str());
+                    return false;
+                }
+                ::unlink(path.c_str());
+                return true;
+#else
+                (void)path;
+                return false;
+#endif
+            }
+
+            // 先按保留时间删除，再从最旧的开始删除直到总大小不超过上限
+            void enforce() {
+                if (_policy.max_total_size == 0 && _policy.max_age.count() == 0)
+                    return;
+                auto files = scan();
+                std::int64_t total = 0;
+                for (auto &e : files)
+                    total += e.size;
+                std::int64_t oldest = (std::time(nullptr) - _policy.max_age.count()) * 1000000000LL;
+                for (auto &e : files) {
+                    bool expired = _policy.max_age.count() > 0 && e.mtime < oldest;
+                    bool over = _policy.max_total_size > 0 && total > static_cast<std::int64_t>(_policy.max_total_size);
+                    if (!expired && !over)
+                        break;
+                    if (::unlink(e.path.c_str()) == 0)
+                        total -= e.size;
+                }
+            }
+
+            void background() {
+                // 最低优先级: 批处理调度并把 nice 调到 19，压缩不与写日志的线程抢 CPU
+#ifdef SCHED_BATCH
+                sched_param param{};
+                ::pthread_setschedparam(::pthread_self(), SCHED_BATCH, &param);
+#endif
+                ::setpriority(PRIO_PROCESS, static_cast<id_t>(::syscall(SYS_gettid)), 19);
+                std::unique_lock<std::mutex> lock{ _lock };
+                bool dirty = true;
+                // 按保留时间清理需要定期检查，没有新文件时也每分钟醒来一次
+                const auto period = std::chrono::seconds(60);
+                while (true) {
+                    if (!_queue.empty()) {
+                        std::string path = std::move(_queue.front());
+                        _queue.pop_front();
+                        _busy = true;
+                        lock.unlock();
+                        if (_policy.compress)
+                            compress(path);
+                        lock.lock();
+                        _busy = false;
+                        dirty = true;
+                        continue;
+                    }
+                    // 队列清空后再清理: 还没压缩的文件按原始大小计算会多删旧归档
+                    if (dirty) {
+                        _busy = true;
+                        lock.unlock();
+                        enforce();
+                        lock.lock();
+                        _busy = false;
+                        dirty = false;
+                        continue;
+                    }
+                    _idle_cv.notify_all();
+                    if (!_run)
+                        break;
+                    _cv.wait_for(lock, period);
+                    dirty = _policy.max_age.count() > 0;
+                }
+            }
+
+            const std::string _base;
+            const archive_policy _policy;
+            std::string _stem;                  // 去掉扩展名的路径，例如 logs/app
+            std::string _ext;                   // 扩展名，例如 .log
+            std::string _dir;                   // 所在目录，以 / 结尾
+            std::string _prefix;                // 归档文件名前缀，例如 app.
+            std::mutex _lock;
+            std::condition_variable _cv;
+            std::condition_variable _idle_cv;
+            std::deque<std::string> _queue;     // 等待压缩的归档文件，_lock 保护
+            bool _busy = true;                  // 后台有未完成的工作 (启动时的清理也算)，_lock 保护
+            bool _run = true;
+            std::thread _worker;
+        };
+
+        // 按大小切换的文件 sink，写满后把文件交给 archiver，而不是像 rotating_file_sink 那样依次改名
+        // 切换时调用线程只做 close/rename/open，压缩和清理在 archiver 的后台线程
+        class archiving_file_sink : public spdlog::sinks::base_sink<std::mutex>
+        {
+        public:
+            archiving_file_sink(std::string filename, std::size_t max_file_size, std::shared_ptr<archiver> archiver)
+                : _base(std::move(filename)), _max_size(max_file_size), _archiver(std::move(archiver)) {
+                _file.open(_base, false);
+                _size = _file.size();
+            }
+
+        protected:
+            void sink_it_(const spdlog::details::log_msg &msg) override {
+                spdlog::memory_buf_t formatted;
+                formatter_->format(msg, formatted);
+                if (_size > 0 && _size + formatted.size() > _max_size) {
+                    _file.close();
+                    _archiver->retire();
+                    _file.open(_base, true);
+                    _size = 0;
+                }
+                _file.write(formatted);
+                _size += formatted.size();
+            }
+
+            void flush_() override { _file.flush(); }
+
+        private:
+            const std::string _base;
+            const std::size_t _max_size;
+            std::shared_ptr<archiver> _archiver;
+            spdlog::details::file_helper _file;
+            std::size_t _size = 0;
+        };
+
+    }  // log
+
+}  // utils
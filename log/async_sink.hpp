@@ -0,0 +1,255 @@
+#pragma once
+
+#include <spdlog/sinks/sink.h>
+#include <spdlog/pattern_formatter.h>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <algorithm>
+
+namespace utils {
+
+    namespace log {
+
+        // 异步队列满时的处理方式
+        enum class overflow_policy {
+            block,              // 调用者等待写线程腾出空间，不丢日志
+            drop_newest,        // 丢弃新日志，调用者立即返回
+            overwrite_oldest,   // 丢弃队列中最旧的日志，腾出位置给新日志
+        };
+
+        // 异步 sink: 调用线程只做格式化 (由 spdlog::logger 完成) 和入队，写文件/终端由后台写线程完成
+        // 队列是预分配的有界 MPMC 环形缓冲区 (Vyukov)，每个槽位自带缓冲区，消息不超过槽位已有容量时入队不分配内存
+        // 多个写线程时不同线程写出的日志之间不保证顺序，默认一个写线程
+        class async_sink : public spdlog::sinks::sink
+        {
+            // 槽位: seq 标记槽位状态，等于 pos 时可写入，等于 pos + 1 时可读取
+            struct slot {
+                std::atomic<std::size_t> seq{ 0 };
+                spdlog::details::log_msg msg;
+                spdlog::memory_buf_t buffer;    // msg.payload 和 msg.logger_name 指向这里
+            };
+
+        public:
+            async_sink(std::vector<spdlog::sink_ptr> sinks, std::size_t queue_size = 8192,
+                       overflow_policy overflow = overflow_policy::block, unsigned writers = 1,
+                       spdlog::level::level_enum flush_level = spdlog::level::warn)
+                : _sinks(std::move(sinks)), _overflow(overflow), _flush_level(flush_level) {
+                std::size_t capacity = 2;
+                while (capacity < queue_size)
+                    capacity <<= 1;
+                _mask = capacity - 1;
+                _slots.reset(new slot[capacity]);
+                for (std::size_t i = 0; i < capacity; ++i)
+                    _slots[i].seq.store(i, std::memory_order_relaxed);
+                for (unsigned i = 0; i < std::max(1u, writers); ++i)
+                    _writers.emplace_back(&async_sink::writer, this);
+            }
+
+            ~async_sink() override { stop(); }
+
+            async_sink(const async_sink&) = delete;
+            async_sink& operator=(const async_sink&) = delete;
+
+            void log(const spdlog::details::log_msg &msg) override {
+                if (!_run.load(std::memory_order_acquire)) {
+                    write(msg);     // 已停止，直接在调用线程写出
+                    return;
+                }
+                while (!push(msg)) {
+                    if (_overflow == overflow_policy::drop_newest) {
+                        _dropped.fetch_add(1, std::memory_order_relaxed);
+                        return;
+                    }
+                    if (_overflow == overflow_policy::overwrite_oldest) {
+                        if (pop([](spdlog::details::log_msg&) { }))
+                            _dropped.fetch_add(1, std::memory_order_relaxed);
+                        continue;
+                    }
+                    if (!_run.load(std::memory_order_acquire)) {
+                        write(msg);
+                        return;
+                    }
+                    wait_space();
+                }
+                _accepted.fetch_add(1, std::memory_order_release);
+                wakeup();
+            }
+
+            // 等待调用前已入队的日志全部写出后刷新下游 sink
+            void flush() override {
+                std::size_t target = _accepted.load(std::memory_order_acquire);
+                std::unique_lock<std::mutex> lock{ _lock };
+                while (_done.load(std::memory_order_acquire) < target && _run.load(std::memory_order_acquire))
+                    _drained.wait_for(lock, std::chrono::milliseconds(1));
+                lock.unlock();
+                for (auto &sink : _sinks)
+                    sink->flush();
+            }
+
+            void set_pattern(const std::string &pattern) override {
+                set_formatter(std::unique_ptr<spdlog::formatter>(new spdlog::pattern_formatter(pattern)));
+            }
+
+            void set_formatter(std::unique_ptr<spdlog::formatter> sink_formatter) override {
+                for (auto &sink : _sinks)
+                    sink->set_formatter(sink_formatter->clone());
+            }
+
+            // 因队列满被丢弃的日志条数 (drop_newest / overwrite_oldest)
+            std::size_t dropped() const { return _dropped.load(std::memory_order_relaxed); }
+
+            const std::vector<spdlog::sink_ptr>& sinks() const { return _sinks; }
+
+            // 写出队列中剩余的日志后停止写线程，之后的日志在调用线程同步写出；可重复调用
+            void stop() {
+                {
+                    std::lock_guard<std::mutex> lock{ _lock };
+                    if (!_run.exchange(false, std::memory_order_acq_rel))
+                        return;
+                    _ready.notify_all();
+                    _space.notify_all();
+                }
+                for (auto &t : _writers)
+                    if (t.joinable())
+                        t.join();
+                while (pop([this](spdlog::details::log_msg &msg) { write(msg); }))
+                    ;
+                for (auto &sink : _sinks)
+                    sink->flush();
+            }
+
+        private:
+            bool push(const spdlog::details::log_msg &msg) {
+                std::size_t pos = _tail.load(std::memory_order_relaxed);
+                for (;;) {
+                    slot &s = _slots[pos & _mask];
+                    std::size_t seq = s.seq.load(std::memory_order_acquire);
+                    std::ptrdiff_t diff = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos);
+                    if (diff == 0) {
+                        if (_tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                            s.buffer.clear();
+                            s.buffer.append(msg.payload.begin(), msg.payload.end());
+                            s.buffer.append(msg.logger_name.begin(), msg.logger_name.end());
+                            s.msg = msg;
+                            s.msg.payload = spdlog::string_view_t(s.buffer.data(), msg.payload.size());
+                            s.msg.logger_name = spdlog::string_view_t(s.buffer.data() + msg.payload.size(), msg.logger_name.size());
+                            s.seq.store(pos + 1, std::memory_order_release);
+                            return true;
+                        }
+                    } else if (diff < 0) {
+                        return false;   // 满
+                    } else {
+                        pos = _tail.load(std::memory_order_relaxed);
+                    }
+                }
+            }
+
+            // 取出一条交给 fn 处理，fn 返回后槽位才归还给生产者
+            template<class F>
+            bool pop(F &&fn) {
+                std::size_t pos = _head.load(std::memory_order_relaxed);
+                for (;;) {
+                    slot &s = _slots[pos & _mask];
+                    std::size_t seq = s.seq.load(std::memory_order_acquire);
+                    std::ptrdiff_t diff = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos + 1);
+                    if (diff == 0) {
+                        if (_head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                            fn(s.msg);
+                            s.seq.store(pos + _mask + 1, std::memory_order_release);
+                            _done.fetch_add(1, std::memory_order_release);
+                            return true;
+                        }
+                    } else if (diff < 0) {
+                        return false;   // 空
+                    } else {
+                        pos = _head.load(std::memory_order_relaxed);
+                    }
+                }
+            }
+
+            bool empty() const {
+                std::size_t pos = _head.load(std::memory_order_seq_cst);
+                return _slots[pos & _mask].seq.load(std::memory_order_seq_cst) != pos + 1;
+            }
+
+            void write(const spdlog::details::log_msg &msg) {
+                for (auto &sink : _sinks) {
+                    if (sink->should_log(msg.level))
+                        sink->log(msg);
+                    if (msg.level >= _flush_level && msg.level != spdlog::level::off)
+                        sink->flush();
+                }
+            }
+
+            // 生产者入队后唤醒睡眠的写线程；与 writer() 中的 _sleeping 配合，seq_cst 保证不会漏唤醒
+            void wakeup() {
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                if (_sleeping.load(std::memory_order_seq_cst) > 0) {
+                    std::lock_guard<std::mutex> lock{ _lock };
+                    _ready.notify_one();
+                }
+            }
+
+            // block 策略下队列满时等待写线程取走日志
+            void wait_space() {
+                std::unique_lock<std::mutex> lock{ _lock };
+                _blocked.fetch_add(1, std::memory_order_relaxed);
+                _space.wait_for(lock, std::chrono::milliseconds(1), [this] {
+                    return !_run.load(std::memory_order_relaxed)
+                        || _slots[_tail.load(std::memory_order_relaxed) & _mask].seq.load(std::memory_order_acquire) == _tail.load(std::memory_order_relaxed);
+                });
+                _blocked.fetch_sub(1, std::memory_order_relaxed);
+            }
+
+            void writer() {
+                for (;;) {
+                    bool wrote = false;
+                    while (pop([this](spdlog::details::log_msg &msg) { write(msg); })) {
+                        wrote = true;
+                        if (_blocked.load(std::memory_order_relaxed) > 0) {
+                            std::lock_guard<std::mutex> lock{ _lock };
+                            _space.notify_all();
+                        }
+                    }
+                    // 队列刚写空，刷新下游，避免低级别日志长时间留在缓冲区
+                    if (wrote)
+                        for (auto &sink : _sinks)
+                            sink->flush();
+                    std::unique_lock<std::mutex> lock{ _lock };
+                    _drained.notify_all();
+                    if (!_run.load(std::memory_order_acquire))
+                        return;
+                    _sleeping.fetch_add(1, std::memory_order_seq_cst);
+                    if (empty())
+                        _ready.wait(lock);
+                    _sleeping.fetch_sub(1, std::memory_order_relaxed);
+                }
+            }
+
+            std::vector<spdlog::sink_ptr> _sinks;
+            const overflow_policy _overflow;
+            const spdlog::level::level_enum _flush_level;  // 不低于此级别的日志写出后立即刷新
+            std::unique_ptr<slot[]> _slots;
+            std::size_t _mask = 0;
+            alignas(64) std::atomic<std::size_t> _tail{ 0 };   // 生产者位置
+            alignas(64) std::atomic<std::size_t> _head{ 0 };   // 写线程位置
+            alignas(64) std::atomic<std::size_t> _accepted{ 0 };  // 入队总数
+            std::atomic<std::size_t> _done{ 0 };                // 写出或被覆盖的总数
+            std::atomic<std::size_t> _dropped{ 0 };
+            std::atomic<int> _sleeping{ 0 };    // 睡眠中的写线程数
+            std::atomic<bool> _run{ true };
+            std::mutex _lock;
+            std::condition_variable _ready;     // 写线程等待日志
+            std::condition_variable _space;     // block 策略下生产者等待空间
+            std::condition_variable _drained;   // flush() 等待之前的日志写出
+            std::atomic<int> _blocked{ 0 };     // 等待空间的生产者数
+            std::vector<std::thread> _writers;
+        };
+
+    }  // log
+
+}  // utils
@@ -0,0 +1,371 @@
+// 日志基准测试: 测量 L* 宏在各种配置下的单次调用延迟分布和吞吐，输出 JSON 或 CSV，便于在修改日志路径前后对比
+//     g++ -std=c++17 -O2 -DSPDLOG_COMPILED_LIB -DSPDLOG_FMT_EXTERNAL benchmark.cpp -o benchmark -pthread -lspdlog -lfmt -lz
+//     ./benchmark --threads 1,4 --targets null --format csv > result.csv
+// 场景 (fmt/printf/filtered/kv 按 目标 x 模式 x 线程数 组合运行):
+//     fmt             LINFO，{} 风格
+//     printf          LINFO，% 风格
+//     filtered        LDEBUG，被 logger 的运行时级别 (info) 过滤，衡量关闭的日志的开销
+//     kv              LINFO_KV，结构化字段
+//     rotating        spdlog rotating_file_sink，用很小的文件频繁切换，不压缩 (原来的行为，作为基线)
+//     archive         archiving_file_sink + 后台 gzip 压缩与保留策略
+//     mmap_archive    mmap_file_sink + 后台 gzip 压缩与保留策略
+// 后三个只测文件目标的同步模式，结果中另有关闭 logger 等待后台完成的时间和目录中的文件数
+// 参数:
+//     --cases fmt,printf        只运行指定场景，默认全部
+//     --threads 1,2,4           写日志的线程数列表，默认 1,2,4 以及 CPU 数
+//     --targets file,null       日志文件写到 --dir 下 (file) 或 /dev/null (null)，默认两者
+//     --modes sync,async        同步写或经 async_sink 由后台线程写，默认两者
+//     --scale 1.0               每个线程的日志条数倍率，机器慢时调小
+//     --file-size 1048576       切换场景的单个文件大小 (字节)
+//     --dir /tmp/logger_bench   在这个目录下新建私有子目录写日志，每个场景开始前清空子目录，结束后删除
+//     --format json|csv         默认 json
+// 延迟包含两次 steady_clock 读取 (约几十纳秒)，对比时看差值
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <algorithm>
+#include <functional>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "logger.hpp"
+
+namespace {
+
+    using clock_type = std::chrono::steady_clock;
+
+    std::int64_t now_ns() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(clock_type::now().time_since_epoch()).count();
+    }
+
+    struct config {
+        std::string dir = "/tmp/logger_bench";
+        std::size_t file_size = 1024 * 1024;
+        double scale = 1.0;
+    };
+
+    // 一次运行的组合
+    struct variant {
+        bool null_target = false;       // 写到 /dev/null
+        bool async = false;
+        unsigned threads = 1;
+    };
+
+    struct result {
+        std::string name;
+        std::string target;
+        std::string mode;
+        unsigned threads = 0;
+        std::int64_t ops = 0;
+        double seconds = 0;             // 写日志线程的耗时
+        double drain_seconds = 0;       // 关闭 logger 的时间: 异步队列写完、后台压缩和清理完成
+        std::int64_t dropped = 0;       // 异步队列满被丢弃的条数
+        std::int64_t files = -1;        // 结束时目录中的文件数，/dev/null 为 -1
+        std::int64_t bytes = -1;        // 结束时目录中文件的总大小
+        std::int64_t p50 = -1;          // 单次调用延迟分位 (纳秒)
+        std::int64_t p99 = -1;
+        std::int64_t p999 = -1;
+        std::int64_t max = -1;
+
+        double rate() const { return seconds > 0 ? ops / seconds : 0; }
+    };
+
+    void percentiles(result &r, std::vector<std::int64_t> &samples) {
+        if (samples.empty())
+            return;
+        std::sort(samples.begin(), samples.end());
+        auto at = [&](double q) { return samples[std::min(samples.size() - 1, static_cast<std::size_t>(q * samples.size()))]; };
+        r.p50 = at(0.50);
+        r.p99 = at(0.99);
+        r.p999 = at(0.999);
+        r.max = samples.back();
+    }
+
+    // 清空 main 新建的私有目录 (不递归)，返回删除前的文件数和总大小
+    void clear_dir(const std::string &path, std::int64_t *files = nullptr, std::int64_t *bytes = nullptr) {
+        std::int64_t count = 0, total = 0;
+        if (DIR *dir = ::opendir(path.c_str())) {
+            while (struct dirent *d = ::readdir(dir)) {
+                if (d->d_name[0] == '.')
+                    continue;
+                std::string file = path + "/" + d->d_name;
+                struct stat st;
+                if (::stat(file.c_str(), &st) == 0 && S_ISREG(st.st_mode)) {
+                    count++;
+                    total += st.st_size;
+                    ::unlink(file.c_str());
+                }
+            }
+            ::closedir(dir);
+        }
+        if (files)
+            *files = count;
+        if (bytes)
+            *bytes = total;
+    }
+
+    utils::log::logger_options make_options(const config &cfg, const variant &v) {
+        utils::log::logger_options opts;
+        if (v.null_target) {
+            // 永远不切换，否则 rotating_file_sink 会去改名 /dev/null
+            opts.filename = "/dev/null";
+            opts.max_file_size = SIZE_MAX / 2;
+        } else {
+            opts.filename = cfg.dir + "/app.log";
+            opts.max_file_size = 1024ull * 1024 * 1024;
+        }
+        opts.max_files = 1000;      // 切换场景保留全部文件，与归档的写入量一致
+        opts.async = v.async;
+        return opts;
+    }
+
+    // 各线程连续调用 body(i, t) per 次，逐次计时
+    template<class Body>
+    result run(const config &cfg, const variant &v, const utils::log::logger_options &opts, Body body) {
+        const std::int64_t per = std::max<std::int64_t>(1, static_cast<std::int64_t>(100000 * cfg.scale));
+        if (!v.null_target)
+            clear_dir(cfg.dir);
+        result r;
+        r.target = v.null_target ? "null" : "file";
+        r.mode = v.async ? "async" : "sync";
+        r.threads = v.threads;
+        r.ops = per * v.threads;
+        std::vector<std::vector<std::int64_t>> samples(v.threads);
+        auto *log = new utils::log::logger(opts);
+        std::int64_t start = now_ns();
+        std::vector<std::thread> writers;
+        for (unsigned t = 0; t < v.threads; ++t)
+            writers.emplace_back([&, t] {
+                auto &mine = samples[t];
+                mine.reserve(per);
+                for (std::int64_t i = 0; i < per; ++i) {
+                    std::int64_t t0 = now_ns();
+                    body(i, t);
+                    mine.push_back(now_ns() - t0);
+                }
+            });
+        for (auto &w : writers)
+            w.join();
+        std::int64_t written = now_ns();
+        r.seconds = (written - start) / 1e9;
+        r.dropped = static_cast<std::int64_t>(log->dropped());
+        delete log;
+        r.drain_seconds = (now_ns() - written) / 1e9;
+        if (!v.null_target)
+            clear_dir(cfg.dir, &r.files, &r.bytes);
+        std::vector<std::int64_t> all;
+        all.reserve(r.ops);
+        for (auto &s : samples)
+            all.insert(all.end(), s.begin(), s.end());
+        percentiles(r, all);
+        return r;
+    }
+
+    result bench_fmt(const config &cfg, const variant &v) {
+        return run(cfg, v, make_options(cfg, v), [](std::int64_t i, unsigned t) {
+            LINFO("request {} from client {} finished in {} us, status {}", i, t, i % 977, "ok");
+        });
+    }
+
+    result bench_printf(const config &cfg, const variant &v) {
+        return run(cfg, v, make_options(cfg, v), [](std::int64_t i, unsigned t) {
+            LINFO("request %lld from client %u finished in %lld us, status %s", (long long)i, t, (long long)(i % 977), "ok");
+        });
+    }
+
+    result bench_filtered(const config &cfg, const variant &v) {
+        return run(cfg, v, make_options(cfg, v), [](std::int64_t i, unsigned t) {
+            LDEBUG("request {} from client {} finished in {} us, status {}", i, t, i % 977, "ok");
+        });
+    }
+
+    result bench_kv(const config &cfg, const variant &v) {
+        return run(cfg, v, make_options(cfg, v), [](std::int64_t i, unsigned t) {
+            LINFO_KV("request.done", "request", i, "client", t, "us", i % 977, "status", "ok");
+        });
+    }
+
+    // 切换场景: 用很小的文件频繁切换，比较各种文件策略下调用者看到的延迟
+    utils::log::logger_options rotation_options(const config &cfg, const variant &v) {
+        auto opts = make_options(cfg, v);
+        opts.max_file_size = cfg.file_size;
+        return opts;
+    }
+
+    void rotation_body(std::int64_t i, unsigned t) {
+        LINFO("request {} from client {} finished in {} us, status {}", i, t, i % 977, "ok");
+    }
+
+    result bench_rotating(const config &cfg, const variant &v) {
+        return run(cfg, v, rotation_options(cfg, v), rotation_body);
+    }
+
+    result bench_archive(const config &cfg, const variant &v) {
+        auto opts = rotation_options(cfg, v);
+        opts.archive = true;
+        return run(cfg, v, opts, rotation_body);
+    }
+
+    result bench_mmap_archive(const config &cfg, const variant &v) {
+        auto opts = rotation_options(cfg, v);
+        opts.archive = true;
+        opts.mmap = true;
+        return run(cfg, v, opts, rotation_body);
+    }
+
+    struct bench_case {
+        const char *name;
+        std::function<result(const config&, const variant&)> fn;
+        bool matrix;                    // 按 目标 x 模式 组合运行；否则只测文件目标的同步模式
+    };
+
+    const bench_case all_cases[] = {
+        { "fmt", bench_fmt, true },
+        { "printf", bench_printf, true },
+        { "filtered", bench_filtered, true },
+        { "kv", bench_kv, true },
+        { "rotating", bench_rotating, false },
+        { "archive", bench_archive, false },
+        { "mmap_archive", bench_mmap_archive, false },
+    };
+
+    std::vector<std::string> split(const std::string &text) {
+        std::vector<std::string> items;
+        std::size_t pos = 0;
+        while (pos <= text.size()) {
+            std::size_t end = text.find(',', pos);
+            if (end == std::string::npos)
+                end = text.size();
+            if (end > pos)
+                items.push_back(text.substr(pos, end - pos));
+            pos = end + 1;
+        }
+        return items;
+    }
+
+    bool contains(const std::vector<std::string> &items, const char *item) {
+        return std::find(items.begin(), items.end(), item) != items.end();
+    }
+
+    void print_csv(const std::vector<result> &results) {
+        std::printf("case,target,mode,threads,ops,seconds,ops_per_sec,p50_ns,p99_ns,p999_ns,max_ns,drain_seconds,dropped,files,bytes\n");
+        for (auto &r : results)
+            std::printf("%s,%s,%s,%u,%lld,%.6f,%.1f,%lld,%lld,%lld,%lld,%.6f,%lld,%lld,%lld\n", r.name.c_str(),
+                        r.target.c_str(), r.mode.c_str(), r.threads, (long long)r.ops, r.seconds, r.rate(),
+                        (long long)r.p50, (long long)r.p99, (long long)r.p999, (long long)r.max, r.drain_seconds,
+                        (long long)r.dropped, (long long)r.files, (long long)r.bytes);
+    }
+
+    void print_json(const std::vector<result> &results) {
+        std::printf("{\n  \"hardware_concurrency\": %u,\n  \"spdlog_active_level\": %d,\n  \"results\": [\n",
+                    std::thread::hardware_concurrency(), SPDLOG_ACTIVE_LEVEL);
+        for (std::size_t i = 0; i < results.size(); ++i) {
+            auto &r = results[i];
+            std::printf("    {\"case\": \"%s\", \"target\": \"%s\", \"mode\": \"%s\", \"threads\": %u, \"ops\": %lld, "
+                        "\"seconds\": %.6f, \"ops_per_sec\": %.1f, \"p50_ns\": %lld, \"p99_ns\": %lld, \"p999_ns\": %lld, "
+                        "\"max_ns\": %lld, \"drain_seconds\": %.6f, \"dropped\": %lld, \"files\": %lld, \"bytes\": %lld}%s\n",
+                        r.name.c_str(), r.target.c_str(), r.mode.c_str(), r.threads, (long long)r.ops, r.seconds,
+                        r.rate(), (long long)r.p50, (long long)r.p99, (long long)r.p999, (long long)r.max,
+                        r.drain_seconds, (long long)r.dropped, (long long)r.files, (long long)r.bytes,
+                        i + 1 < results.size() ? "," : "");
+        }
+        std::printf("  ]\n}\n");
+    }
+
+}  // namespace
+
+int main(int argc, char *argv[])
+{
+    config cfg;
+    std::vector<unsigned> thread_counts{ 1, 2, 4 };
+    unsigned cpus = std::max(1u, std::thread::hardware_concurrency());
+    if (std::find(thread_counts.begin(), thread_counts.end(), cpus) == thread_counts.end())
+        thread_counts.push_back(cpus);
+    std::vector<std::string> selected;
+    std::vector<std::string> targets{ "file", "null" };
+    std::vector<std::string> modes{ "sync", "async" };
+    bool csv = false;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (arg == "--cases" && value) {
+            selected = split(argv[++i]);
+        } else if (arg == "--threads" && value) {
+            thread_counts.clear();
+            for (auto &item : split(argv[++i]))
+                thread_counts.push_back(static_cast<unsigned>(std::max(1, std::atoi(item.c_str()))));
+        } else if (arg == "--targets" && value) {
+            targets = split(argv[++i]);
+        } else if (arg == "--modes" && value) {
+            modes = split(argv[++i]);
+        } else if (arg == "--scale" && value) {
+            cfg.scale = std::atof(argv[++i]);
+        } else if (arg == "--file-size" && value) {
+            cfg.file_size = static_cast<std::size_t>(std::max(4096LL, std::atoll(argv[++i])));
+        } else if (arg == "--dir" && value) {
+            cfg.dir = argv[++i];
+        } else if (arg == "--format" && value) {
+            csv = std::strcmp(argv[++i], "csv") == 0;
+        } else {
+            std::fprintf(stderr, "usage: %s [--cases fmt,printf,filtered,kv,rotating,archive,mmap_archive] "
+                                 "[--threads 1,2,4] [--targets file,null] [--modes sync,async] [--scale 1.0] "
+                                 "[--file-size 1048576] [--dir /tmp/logger_bench] [--format json|csv]\n", argv[0]);
+            return 1;
+        }
+    }
+    // 只在自己新建的子目录里写和删除文件，--dir 指向 /tmp 或 . 也不会误删别的文件
+    ::mkdir(cfg.dir.c_str(), 0755);
+    std::string private_dir = cfg.dir + "/run.XXXXXX";
+    if (!::mkdtemp(&private_dir[0])) {
+        std::fprintf(stderr, "benchmark failed: cannot create a directory under %s\n", cfg.dir.c_str());
+        return 1;
+    }
+    cfg.dir = private_dir;
+
+    std::vector<result> results;
+    try {
+        for (auto &bench : all_cases) {
+            if (!selected.empty() && !contains(selected, bench.name))
+                continue;
+            for (unsigned threads : thread_counts) {
+                for (bool null_target : { false, true }) {
+                    if (!contains(targets, null_target ? "null" : "file") || (!bench.matrix && null_target))
+                        continue;
+                    for (bool async : { false, true }) {
+                        if (!contains(modes, async ? "async" : "sync") || (!bench.matrix && async))
+                            continue;
+                        variant v;
+                        v.null_target = null_target;
+                        v.async = async;
+                        v.threads = threads;
+                        result r = bench.fn(cfg, v);
+                        r.name = bench.name;
+                        results.push_back(r);
+                    }
+                }
+            }
+        }
+    }
+    catch (std::exception &e) {
+        std::fprintf(stderr, "benchmark failed: %s\n", e.what());
+        clear_dir(cfg.dir);
+        ::rmdir(cfg.dir.c_str());
+        return 1;
+    }
+    clear_dir(cfg.dir);
+    ::rmdir(cfg.dir.c_str());
+
+    if (csv)
+        print_csv(results);
+    else
+        print_json(results);
+    return 0;
+}
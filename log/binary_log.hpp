@@ -0,0 +1,410 @@
+#pragma once
+
+#include <spdlog/common.h>
+#include <spdlog/details/os.h>
+#include <fmt/format.h>
+#include <vector>
+#include <memory>
+#include <iterator>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <cerrno>
+#include <type_traits>
+
+#define LOGGER_BINARY_BUFFER_SIZE (1 << 20)     // 每个线程的二进制日志缓冲区 (字节)，必须是 2 的幂
+
+namespace utils {
+
+    namespace log {
+
+        // 延迟格式化的二进制日志 (NanoLog 方式)
+        // 调用点第一次执行时登记格式串和源码位置，之后每次调用只向本线程缓冲区写入 {编号, 时间戳, 参数原始字节}
+        // 后台线程把各线程缓冲区的记录和新登记的调用点写入二进制文件，由 log/decoder.cpp 离线还原成文本
+        // 文件格式 (小端):
+        //     文件头  "ULOGBIN1"
+        //     'S' 调用点: u32 编号, u8 级别, u32 行号, str 文件, str 函数, str 格式串, str 参数类型签名
+        //     'C' 记录块: u64 线程号, u32 字节数, 若干记录
+        //     记录: u32 调用点编号, u32 参数字节数, i64 时间戳 (system_clock 纳秒), 参数
+        //     str: u32 长度 + 字节
+        // 参数类型签名每个参数一个字符: i 有符号整数 (i64), u 无符号整数 (u64), b 布尔 (u8), c 字符 (u8),
+        //     f 浮点 (double), p 指针 (u64), s 字符串 (u32 长度 + 字节，其他类型在调用线程格式化成字符串)
+        namespace binary {
+
+            static constexpr char file_magic[8] = { 'U', 'L', 'O', 'G', 'B', 'I', 'N', '1' };
+            static constexpr std::uint32_t wrap_marker = 0xffffffffu;  // 缓冲区尾部剩余空间不够放下一条记录，跳到开头
+            static constexpr std::size_t record_header = 16;
+
+            // 调用点，宏里以 static 变量定义，第一次写日志时登记并得到编号
+            struct site
+            {
+                spdlog::level::level_enum level;
+                const char *fmt;
+                const char *file;
+                int line;
+                const char *func;
+                const char *signature = nullptr;
+                std::atomic<std::uint32_t> id{ 0 };
+
+                constexpr site(spdlog::level::level_enum level, const char *fmt, const char *file, int line, const char *func)
+                    : level(level), fmt(fmt), file(file), line(line), func(func) { }
+            };
+
+            namespace detail {
+                // 单生产者 (所属线程) 单消费者 (写线程) 字节环形缓冲区，位置单调递增
+                struct thread_buffer
+                {
+                    std::unique_ptr<char[]> data{ new char[LOGGER_BINARY_BUFFER_SIZE] };
+                    alignas(64) std::atomic<std::size_t> head{ 0 };     // 写线程读到的位置
+                    alignas(64) std::atomic<std::size_t> tail{ 0 };     // 所属线程写到的位置
+                    std::uint64_t tid = spdlog::details::os::thread_id();
+                    std::atomic<bool> retired{ false };                 // 所属线程已退出，读空后释放
+                };
+
+                template<class T, class = void>
+                struct arg_traits { static constexpr char tag = 's'; };   // 其他类型先格式化成字符串
+                template<> struct arg_traits<bool> { static constexpr char tag = 'b'; };
+                template<> struct arg_traits<char> { static constexpr char tag = 'c'; };
+                template<> struct arg_traits<std::string> { static constexpr char tag = 's'; };
+                template<> struct arg_traits<const char*> { static constexpr char tag = 's'; };
+                template<> struct arg_traits<char*> { static constexpr char tag = 's'; };
+                template<class T>
+                struct arg_traits<T, typename std::enable_if<std::is_integral<T>::value && !std::is_same<T, bool>::value && !std::is_same<T, char>::value>::type> {
+                    static constexpr char tag = std::is_signed<T>::value ? 'i' : 'u';
+                };
+                template<class T>
+                struct arg_traits<T, typename std::enable_if<std::is_floating_point<T>::value>::type> { static constexpr char tag = 'f'; };
+                template<class T>
+                struct arg_traits<T, typename std::enable_if<std::is_enum<T>::value>::type> {
+                    static constexpr char tag = std::is_signed<typename std::underlying_type<T>::type>::value ? 'i' : 'u';
+                };
+                template<class T>
+                struct arg_traits<T*, typename std::enable_if<!std::is_same<typename std::remove_cv<T>::type, char>::value>::type> {
+                    static constexpr char tag = 'p';
+                };
+
+                template<class T>
+                using stored_t = typename std::decay<T>::type;
+
+                template<class... Args>
+                const char* signature() {
+                    static const char sig[] = { arg_traits<stored_t<Args>>::tag..., '\0' };
+                    return sig;
+                }
+
+                // 按字符串记录的其他类型，在调用线程格式化一次，之后按格式化结果计算长度和写入
+                struct formatted { spdlog::memory_buf_t text; };
+
+                // 写入前整理参数: 其他类型格式化成 formatted，char* 按 const char* 处理，其余原样引用
+                template<class T>
+                decltype(auto) stage(const T &value) {
+                    if constexpr (std::is_same<T, char*>::value) {
+                        return static_cast<const char*>(value);
+                    } else if constexpr (arg_traits<T>::tag == 's' && !std::is_same<T, std::string>::value && !std::is_same<T, const char*>::value) {
+                        formatted f;
+                        fmt::format_to(std::back_inserter(f.text), "{}", value);
+                        return f;
+                    } else {
+                        return (value);
+                    }
+                }
+
+                // 记录中参数的字节数
+                inline std::size_t arg_size(const char *s) { return 4 + (s ? std::strlen(s) : 0); }
+                inline std::size_t arg_size(const std::string &s) { return 4 + s.size(); }
+                inline std::size_t arg_size(const formatted &f) { return 4 + f.text.size(); }
+                template<class T>
+                std::size_t arg_size(const T &) {
+                    constexpr char tag = arg_traits<T>::tag;
+                    static_assert(tag != 's', "string arguments must be staged first");
+                    return tag == 'b' || tag == 'c' ? 1 : 8;
+                }
+
+                inline char* put_string(char *out, const char *s, std::size_t len) {
+                    std::uint32_t n = static_cast<std::uint32_t>(len);
+                    std::memcpy(out, &n, 4);
+                    std::memcpy(out + 4, s, len);
+                    return out + 4 + len;
+                }
+
+                inline char* put(char *out, const char *s) { return put_string(out, s ? s : "", s ? std::strlen(s) : 0); }
+                inline char* put(char *out, const std::string &s) { return put_string(out, s.data(), s.size()); }
+                inline char* put(char *out, const formatted &f) { return put_string(out, f.text.data(), f.text.size()); }
+                template<class T>
+                char* put(char *out, const T &value) {
+                    constexpr char tag = arg_traits<T>::tag;
+                    static_assert(tag != 's', "string arguments must be staged first");
+                    if constexpr (tag == 'b' || tag == 'c') {
+                        *out = static_cast<char>(value);
+                        return out + 1;
+                    } else {
+                        using wide = typename std::conditional<tag == 'i', std::int64_t,
+                                     typename std::conditional<tag == 'u', std::uint64_t,
+                                     typename std::conditional<tag == 'f', double, std::uint64_t>::type>::type>::type;
+                        wide v;
+                        if constexpr (tag == 'p')
+                            v = reinterpret_cast<std::uintptr_t>(value);
+                        else
+                            v = static_cast<wide>(value);
+                        std::memcpy(out, &v, 8);
+                        return out + 8;
+                    }
+                }
+
+                inline void put_all(char *) { }
+                template<class T, class... Rest>
+                void put_all(char *out, const T &value, const Rest&... rest) {
+                    put_all(put(out, value), rest...);
+                }
+            }  // detail
+
+            // 后台写线程和调用点登记表，进程内唯一
+            class backend
+            {
+            public:
+                static backend& instance() {
+                    static backend inst;
+                    return inst;
+                }
+
+                ~backend() { stop(); }
+
+                // 打开文件并启动写线程，已启动时先停止
+                void start(const std::string &path) {
+                    stop();
+                    std::lock_guard<std::mutex> lock{ _lock };
+                    _file = std::fopen(path.c_str(), "wb");
+                    if (!_file)
+                        throw spdlog::spdlog_ex("open binary log failed: " + path, errno);
+                    std::fwrite(binary::file_magic, 1, sizeof(binary::file_magic), _file);
+                    _emitted = 0;
+                    _run.store(true, std::memory_order_release);
+                    _thread = std::thread(&backend::writer, this);
+                }
+
+                // 写出所有缓冲区中的记录后停止；可重复调用
+                void stop() {
+                    if (!_run.exchange(false, std::memory_order_acq_rel))
+                        return;
+                    if (_thread.joinable())
+                        _thread.join();
+                    std::lock_guard<std::mutex> lock{ _lock };
+                    drain();
+                    std::fclose(_file);
+                    _file = nullptr;
+                }
+
+                bool running() const { return _run.load(std::memory_order_acquire); }
+
+                // 后台线程没跟上或未启动时丢弃的记录数
+                std::size_t dropped() const { return _dropped.load(std::memory_order_relaxed); }
+
+                template<class... Args>
+                std::uint32_t id_of(site &s) {
+                    std::uint32_t id = s.id.load(std::memory_order_acquire);
+                    if (id != 0)
+                        return id;
+                    std::lock_guard<std::mutex> lock{ _lock };
+                    id = s.id.load(std::memory_order_relaxed);
+                    if (id == 0) {
+                        s.signature = detail::signature<Args...>();
+                        _sites.push_back(&s);
+                        id = static_cast<std::uint32_t>(_sites.size());
+                        s.id.store(id, std::memory_order_release);
+                    }
+                    return id;
+                }
+
+                // 本线程的缓冲区，第一次使用时登记给写线程
+                detail::thread_buffer& local() {
+                    struct holder {
+                        std::shared_ptr<detail::thread_buffer> buf;
+                        ~holder() {
+                            if (buf)
+                                buf->retired.store(true, std::memory_order_release);
+                        }
+                    };
+                    thread_local holder h;
+                    if (!h.buf) {
+                        h.buf = std::make_shared<detail::thread_buffer>();
+                        std::lock_guard<std::mutex> lock{ _lock };
+                        _buffers.push_back(h.buf);
+                    }
+                    return *h.buf;
+                }
+
+                // 在缓冲区中预留 size 字节，空间不够时等待写线程；记录过大或写线程已停止时返回空
+                char* reserve(detail::thread_buffer &buf, std::size_t size) {
+                    constexpr std::size_t capacity = LOGGER_BINARY_BUFFER_SIZE;
+                    if (size > capacity / 2) {
+                        _dropped.fetch_add(1, std::memory_order_relaxed);
+                        return nullptr;
+                    }
+                    std::size_t tail = buf.tail.load(std::memory_order_relaxed);
+                    std::size_t room = capacity - (tail & (capacity - 1));  // 到缓冲区末尾的连续空间
+                    std::size_t need = room < size ? room + size : size;
+                    while (capacity - (tail - buf.head.load(std::memory_order_acquire)) < need) {
+                        if (!running()) {
+                            _dropped.fetch_add(1, std::memory_order_relaxed);
+                            return nullptr;
+                        }
+                        std::this_thread::yield();
+                    }
+                    if (room < size) {
+                        if (room >= record_header)
+                            std::memcpy(&buf.data[tail & (capacity - 1)], &wrap_marker, 4);
+                        tail += room;
+                        buf.tail.store(tail, std::memory_order_release);
+                    }
+                    return &buf.data[tail & (capacity - 1)];
+                }
+
+                void commit(detail::thread_buffer &buf, std::size_t size) {
+                    buf.tail.store(buf.tail.load(std::memory_order_relaxed) + size, std::memory_order_release);
+                }
+
+            private:
+                backend() = default;
+
+                void writer() {
+                    while (_run.load(std::memory_order_acquire)) {
+                        bool wrote;
+                        {
+                            std::lock_guard<std::mutex> lock{ _lock };
+                            wrote = drain();
+                        }
+                        if (!wrote)
+                            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                    }
+                }
+
+                // 把各缓冲区中已提交的记录写入文件，调用者持有 _lock
+                // 先取各缓冲区的记录再写调用点: 记录可见时它引用的调用点一定已经登记
+                bool drain() {
+                    constexpr std::size_t capacity = LOGGER_BINARY_BUFFER_SIZE;
+                    bool wrote = false;
+                    for (std::size_t i = 0; i < _buffers.size();) {
+                        auto &buf = *_buffers[i];
+                        bool retired = buf.retired.load(std::memory_order_acquire);
+                        std::size_t head = buf.head.load(std::memory_order_relaxed);
+                        std::size_t tail = buf.tail.load(std::memory_order_acquire);
+                        _chunk.clear();
+                        while (head != tail) {
+                            std::size_t offset = head & (capacity - 1);
+                            std::size_t room = capacity - offset;
+                            std::uint32_t id = wrap_marker;
+                            if (room >= record_header)
+                                std::memcpy(&id, &buf.data[offset], 4);
+                            if (id == wrap_marker) {
+                                head += room;
+                                continue;
+                            }
+                            std::uint32_t args;
+                            std::memcpy(&args, &buf.data[offset + 4], 4);
+                            _chunk.insert(_chunk.end(), &buf.data[offset], &buf.data[offset] + record_header + args);
+                            head += record_header + args;
+                        }
+                        buf.head.store(head, std::memory_order_release);
+                        if (!_chunk.empty()) {
+                            emit_sites();
+                            std::uint32_t size = static_cast<std::uint32_t>(_chunk.size());
+                            std::fputc('C', _file);
+                            std::fwrite(&buf.tid, 8, 1, _file);
+                            std::fwrite(&size, 4, 1, _file);
+                            std::fwrite(_chunk.data(), 1, _chunk.size(), _file);
+                            wrote = true;
+                        }
+                        if (retired && buf.head.load(std::memory_order_relaxed) == buf.tail.load(std::memory_order_acquire))
+                            _buffers.erase(_buffers.begin() + i);
+                        else
+                            ++i;
+                    }
+                    if (wrote)
+                        std::fflush(_file);
+                    return wrote;
+                }
+
+                void put_string(const char *s) {
+                    std::uint32_t n = static_cast<std::uint32_t>(std::strlen(s));
+                    std::fwrite(&n, 4, 1, _file);
+                    std::fwrite(s, 1, n, _file);
+                }
+
+                // 写出尚未写入当前文件的调用点
+                void emit_sites() {
+                    for (; _emitted < _sites.size(); ++_emitted) {
+                        const site &s = *_sites[_emitted];
+                        std::uint32_t id = static_cast<std::uint32_t>(_emitted + 1);
+                        std::uint8_t level = static_cast<std::uint8_t>(s.level);
+                        std::uint32_t line = static_cast<std::uint32_t>(s.line);
+                        std::fputc('S', _file);
+                        std::fwrite(&id, 4, 1, _file);
+                        std::fwrite(&level, 1, 1, _file);
+                        std::fwrite(&line, 4, 1, _file);
+                        put_string(s.file);
+                        put_string(s.func);
+                        put_string(s.fmt);
+                        put_string(s.signature);
+                    }
+                }
+
+                std::mutex _lock;
+                std::vector<site*> _sites;                  // 下标 + 1 为调用点编号
+                std::size_t _emitted = 0;                   // 已写入当前文件的调用点数
+                std::vector<std::shared_ptr<detail::thread_buffer>> _buffers;
+                std::vector<char> _chunk;
+                std::FILE *_file = nullptr;
+                std::atomic<bool> _run{ false };
+                std::atomic<std::size_t> _dropped{ 0 };
+                std::thread _thread;
+            };
+
+            // 运行时是否启用二进制模式，由 logger_options::binary 打开
+            inline std::atomic<bool> &enabled_flag() {
+                static std::atomic<bool> flag{ false };
+                return flag;
+            }
+
+            inline bool enabled() { return enabled_flag().load(std::memory_order_relaxed); }
+
+            // 参数已经整理好 (detail::stage)，长度和写入的内容来自同一份数据
+            template<class... Staged>
+            void write_record(backend &b, std::uint32_t id, const Staged&... args) {
+                std::size_t args_size = 0;
+                ((args_size += detail::arg_size(args)), ...);
+                auto &buf = b.local();
+                char *out = b.reserve(buf, record_header + args_size);
+                if (!out)
+                    return;
+                std::uint32_t size = static_cast<std::uint32_t>(args_size);
+                std::int64_t ts = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::system_clock::now().time_since_epoch()).count();
+                std::memcpy(out, &id, 4);
+                std::memcpy(out + 4, &size, 4);
+                std::memcpy(out + 8, &ts, 8);
+                detail::put_all(out + record_header, args...);
+                b.commit(buf, record_header + args_size);
+            }
+
+            template<class... Args>
+            void write_stored(site &s, const Args&... args) {
+                backend &b = backend::instance();
+                write_record(b, b.id_of<Args...>(s), detail::stage(args)...);
+            }
+
+            // 写一条二进制日志，参数按 detail::stored_t 衰减 (字符数组按字符串处理)
+            template<class... Args>
+            void write(site &s, const Args&... args) {
+                write_stored<detail::stored_t<const Args&>...>(s, args...);
+            }
+
+        }  // binary
+
+    }  // log
+
+}  // utils
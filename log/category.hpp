@@ -0,0 +1,117 @@
+#pragma once
+
+#include <spdlog/common.h>
+#include <vector>
+#include <string>
+#include <mutex>
+#include <atomic>
+#include <algorithm>
+
+namespace utils {
+
+    namespace log {
+
+        // 日志分类 (模块)，每个分类有自己的运行时级别，与 logger 的级别无关
+        // 用 LOGGER_CATEGORY 定义，用 LCTRACE...LCFATAL 输出
+        class category_base
+        {
+        public:
+            const char* name() const { return _name; }
+
+            spdlog::level::level_enum level() const {
+                return static_cast<spdlog::level::level_enum>(_level.load(std::memory_order_relaxed));
+            }
+
+            void set_level(spdlog::level::level_enum level) { _level.store(level, std::memory_order_relaxed); }
+
+            // 一次 relaxed 读，在对参数求值之前调用
+            bool should_log(spdlog::level::level_enum level) const {
+                return level >= _level.load(std::memory_order_relaxed);
+            }
+
+            category_base(const category_base&) = delete;
+            category_base& operator=(const category_base&) = delete;
+
+        protected:
+            category_base(const char *name, spdlog::level::level_enum level);
+
+            const char *_name;
+            std::atomic<int> _level;
+        };
+
+        namespace detail {
+            struct category_registry {
+                std::mutex lock;
+                std::vector<category_base*> all;
+            };
+
+            inline category_registry& categories() {
+                static category_registry registry;
+                return registry;
+            }
+        }  // detail
+
+        inline category_base::category_base(const char *name, spdlog::level::level_enum level)
+            : _name(name), _level(level) {
+            auto &registry = detail::categories();
+            std::lock_guard<std::mutex> lock{ registry.lock };
+            registry.all.push_back(this);
+        }
+
+        // Floor 为编译期下限 (SPDLOG_LEVEL_*)，低于它的 LC* 调用在编译期去掉，运行时调低级别也不会输出
+        template<int Floor>
+        class category : public category_base
+        {
+        public:
+            static constexpr int floor = Floor;
+
+            explicit category(const char *name, spdlog::level::level_enum level = spdlog::level::info)
+                : category_base(name, level) { }
+        };
+
+        // 按名字设置分类的运行时级别，找不到返回 false
+        inline bool set_level(const std::string &name, spdlog::level::level_enum level) {
+            auto &registry = detail::categories();
+            std::lock_guard<std::mutex> lock{ registry.lock };
+            auto it = std::find_if(registry.all.begin(), registry.all.end(),
+                                   [&](category_base *c) { return name == c->name(); });
+            if (it == registry.all.end())
+                return false;
+            (*it)->set_level(level);
+            return true;
+        }
+
+        // 批量设置，格式 "rpc=debug,udev=warn"，便于从环境变量或配置文件读取
+        // 返回成功设置的分类数，无法识别的项被忽略
+        inline int set_levels(const std::string &spec) {
+            int count = 0;
+            std::size_t pos = 0;
+            while (pos < spec.size()) {
+                std::size_t end = spec.find(',', pos);
+                if (end == std::string::npos)
+                    end = spec.size();
+                std::string item = spec.substr(pos, end - pos);
+                std::size_t eq = item.find('=');
+                if (eq != std::string::npos) {
+                    auto level = spdlog::level::from_str(item.substr(eq + 1));
+                    // from_str 对无法识别的名字返回 off，只有明确写 off 时才接受
+                    if ((level != spdlog::level::off || item.compare(eq + 1, std::string::npos, "off") == 0)
+                        && set_level(item.substr(0, eq), level))
+                        count++;
+                }
+                pos = end + 1;
+            }
+            return count;
+        }
+
+    }  // log
+
+}  // utils
+
+// 定义一个日志分类，floor 为编译期下限；需要在全局命名空间使用
+//     LOGGER_CATEGORY(storage, SPDLOG_LEVEL_DEBUG)
+//     LCDEBUG(storage, "flush {} pages", n);
+#define LOGGER_CATEGORY(name, floor)                                                  \
+    namespace utils { namespace log { namespace categories {                          \
+        inline category<floor> name{ #name };                                         \
+    } } }
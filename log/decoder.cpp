@@ -0,0 +1,200 @@
+// 二进制日志 (binary_log.hpp) 解码工具，输出与 logger 相同格式 (pattern.hpp) 的文本
+//     g++ -std=c++17 -O2 decoder.cpp -o decoder -lspdlog -lfmt
+//     ./decoder app.log.bin > app.txt
+// 参数:
+//     -p pattern    输出格式，默认与 logger 相同
+//     -u            不按时间排序，按文件中的顺序输出 (同一线程内本来就是时间顺序)
+
+#include <spdlog/spdlog.h>
+#include <spdlog/pattern_formatter.h>
+#include <fmt/args.h>
+#include <fmt/printf.h>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <map>
+#include <fstream>
+#include <iterator>
+#include <algorithm>
+#include <stdexcept>
+
+#include "pattern.hpp"
+
+namespace {
+
+    struct site_info {
+        spdlog::level::level_enum level;
+        std::uint32_t line;
+        std::string file, func, fmt, signature;
+        bool printf_style;
+    };
+
+    struct record {
+        std::int64_t ts;
+        std::uint64_t tid;
+        std::uint32_t site;
+        const char *args;
+        std::uint32_t size;
+    };
+
+    // 按顺序读取文件内容，越界时抛出异常
+    class reader
+    {
+    public:
+        reader(const char *data, std::size_t size) : _p(data), _end(data + size) { }
+
+        bool done() const { return _p == _end; }
+        const char* pos() const { return _p; }
+
+        template<class T>
+        T get() {
+            T v;
+            std::memcpy(&v, take(sizeof(T)), sizeof(T));
+            return v;
+        }
+
+        std::string str() {
+            std::uint32_t n = get<std::uint32_t>();
+            const char *p = take(n);
+            return std::string(p, n);
+        }
+
+        const char* take(std::size_t n) {
+            if (static_cast<std::size_t>(_end - _p) < n)
+                throw std::runtime_error("truncated binary log");
+            const char *p = _p;
+            _p += n;
+            return p;
+        }
+
+    private:
+        const char *_p;
+        const char *_end;
+    };
+
+    // 按调用点的参数签名把参数放进 fmt 的动态参数表
+    template<class Store>
+    void load_args(Store &store, const std::string &signature, reader in) {
+        for (char tag : signature) {
+            switch (tag) {
+            case 'i': store.push_back(in.get<std::int64_t>()); break;
+            case 'u': store.push_back(in.get<std::uint64_t>()); break;
+            case 'b': store.push_back(in.get<char>() != 0); break;
+            case 'c': store.push_back(in.get<char>()); break;
+            case 'f': store.push_back(in.get<double>()); break;
+            case 'p': store.push_back(reinterpret_cast<const void*>(static_cast<std::uintptr_t>(in.get<std::uint64_t>()))); break;
+            case 's': store.push_back(in.str()); break;
+            default: throw std::runtime_error(std::string("unknown argument type ") + tag);
+            }
+        }
+    }
+
+    std::string format_payload(const site_info &site, const record &rec) {
+        reader in(rec.args, rec.size);
+        try {
+            if (site.printf_style) {
+                fmt::dynamic_format_arg_store<fmt::printf_context> store;
+                load_args(store, site.signature, in);
+                return fmt::vsprintf(fmt::string_view(site.fmt), store);
+            }
+            fmt::dynamic_format_arg_store<fmt::format_context> store;
+            load_args(store, site.signature, in);
+            return fmt::vformat(site.fmt, store);
+        } catch (std::exception &e) {
+            return site.fmt + " <decode error: " + e.what() + ">";
+        }
+    }
+
+}  // namespace
+
+int main(int argc, char *argv[])
+{
+    std::string pattern = utils::log::default_pattern;
+    const char *path = nullptr;
+    bool sorted = true;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "-p") == 0 && i + 1 < argc)
+            pattern = argv[++i];
+        else if (std::strcmp(argv[i], "-u") == 0)
+            sorted = false;
+        else if (!path && argv[i][0] != '-')
+            path = argv[i];
+        else
+            path = nullptr, i = argc;
+    }
+    if (!path) {
+        std::fprintf(stderr, "usage: %s [-p pattern] [-u] file.bin\n", argv[0]);
+        return 1;
+    }
+
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        std::fprintf(stderr, "open %s failed\n", path);
+        return 1;
+    }
+    std::vector<char> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    std::map<std::uint32_t, site_info> sites;
+    std::vector<record> records;
+    try {
+        reader in(data.data(), data.size());
+        if (std::memcmp(in.take(8), "ULOGBIN1", 8) != 0)
+            throw std::runtime_error("not a binary log");
+        while (!in.done()) {
+            char tag = in.get<char>();
+            if (tag == 'S') {
+                std::uint32_t id = in.get<std::uint32_t>();
+                site_info site;
+                site.level = static_cast<spdlog::level::level_enum>(in.get<std::uint8_t>());
+                site.line = in.get<std::uint32_t>();
+                site.file = in.str();
+                site.func = in.str();
+                site.fmt = in.str();
+                site.signature = in.str();
+                site.printf_style = site.fmt.find('%') != std::string::npos;
+                sites[id] = std::move(site);
+            } else if (tag == 'C') {
+                std::uint64_t tid = in.get<std::uint64_t>();
+                std::uint32_t size = in.get<std::uint32_t>();
+                reader chunk(in.take(size), size);
+                while (!chunk.done()) {
+                    record rec;
+                    rec.tid = tid;
+                    rec.site = chunk.get<std::uint32_t>();
+                    rec.size = chunk.get<std::uint32_t>();
+                    rec.ts = chunk.get<std::int64_t>();
+                    rec.args = chunk.take(rec.size);
+                    records.push_back(rec);
+                }
+            } else {
+                throw std::runtime_error("corrupt binary log");
+            }
+        }
+    } catch (std::exception &e) {
+        // 进程崩溃时文件尾部可能不完整，已经读出的记录照常输出
+        std::fprintf(stderr, "%s: %s, %zu records decoded\n", path, e.what(), records.size());
+    }
+
+    if (sorted)
+        std::stable_sort(records.begin(), records.end(), [](const record &a, const record &b) { return a.ts < b.ts; });
+
+    spdlog::pattern_formatter formatter(pattern);
+    spdlog::memory_buf_t out;
+    for (auto &rec : records) {
+        auto it = sites.find(rec.site);
+        if (it == sites.end())
+            continue;
+        const site_info &site = it->second;
+        std::string payload = format_payload(site, rec);
+        spdlog::details::log_msg msg(spdlog::source_loc{ site.file.c_str(), static_cast<int>(site.line), site.func.c_str() },
+                                     "", site.level, payload);
+        msg.time = spdlog::log_clock::time_point(std::chrono::duration_cast<spdlog::log_clock::duration>(std::chrono::nanoseconds(rec.ts)));
+        msg.thread_id = static_cast<std::size_t>(rec.tid);
+        out.clear();
+        formatter.format(msg, out);
+        std::fwrite(out.data(), 1, out.size(), stdout);
+    }
+    return 0;
+}
@@ -0,0 +1,271 @@
+#pragma once
+
+#include <spdlog/sinks/sink.h>
+#include <spdlog/details/os.h>
+#include <memory>
+#include <string>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <ctime>
+#include <cstring>
+#include <cstdint>
+#include <csignal>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace utils {
+
+    namespace log {
+
+        // 飞行记录器: 在内存环形缓冲区中保留最近的日志 (含 debug/trace)，平时不写出
+        // 出现 error 及以上级别的日志、收到 SIGSEGV/SIGABRT 等致命信号、或调用 dump() 时追加写入文件
+        // 每条记录占一个固定大小的槽位，超长的消息被截断；写满后覆盖最旧的记录
+        // 转储只用 open/write/close 和栈上缓冲区，可以在信号处理函数中调用
+        class flight_recorder : public spdlog::sinks::sink
+        {
+            static constexpr std::size_t text_size = 232;   // 每条消息最多保留的字节数
+
+            struct slot {
+                std::atomic_flag busy = ATOMIC_FLAG_INIT;   // 写入或转储时占用，转储方只尝试一次，不会在信号处理中死等
+                std::uint64_t seq = 0;                      // 记录序号 + 1，0 表示空槽
+                std::int64_t time = 0;                      // system_clock 纳秒
+                std::uint64_t tid = 0;
+                const char *file = nullptr;                 // 源码位置来自字面量，可以只保存指针
+                const char *func = nullptr;
+                int line = 0;
+                spdlog::level::level_enum level = spdlog::level::trace;
+                std::uint16_t len = 0;
+                char text[text_size];
+            };
+
+        public:
+            // records 为保留的记录条数 (向上取整到 2 的幂)，dump_level 及以上级别的日志触发转储
+            flight_recorder(std::string path, std::size_t records = 4096,
+                            spdlog::level::level_enum dump_level = spdlog::level::err)
+                : _path(std::move(path)), _dump_level(dump_level) {
+                std::size_t capacity = 2;
+                while (capacity < records)
+                    capacity <<= 1;
+                _mask = capacity - 1;
+                _slots.reset(new slot[capacity]);
+                std::time_t now = std::time(nullptr);
+                std::tm local;
+                ::localtime_r(&now, &local);
+                _utc_offset = local.tm_gmtoff;     // 信号处理中不能调用 localtime，先记下时区偏移
+            }
+
+            ~flight_recorder() override { uninstall_signal_handlers(); }
+
+            flight_recorder(const flight_recorder&) = delete;
+            flight_recorder& operator=(const flight_recorder&) = delete;
+
+            void log(const spdlog::details::log_msg &msg) override {
+                std::uint64_t seq = _next.fetch_add(1, std::memory_order_relaxed);
+                slot &s = _slots[seq & _mask];
+                while (s.busy.test_and_set(std::memory_order_acquire))
+                    ;   // 只有缓冲区在一次写入期间绕了一圈或正在转储时才会等待
+                s.seq = seq + 1;
+                s.time = std::chrono::duration_cast<std::chrono::nanoseconds>(msg.time.time_since_epoch()).count();
+                s.tid = msg.thread_id;
+                s.file = msg.source.filename;
+                s.func = msg.source.funcname;
+                s.line = msg.source.line;
+                s.level = msg.level;
+                s.len = static_cast<std::uint16_t>(std::min(msg.payload.size(), text_size));
+                std::memcpy(s.text, msg.payload.data(), s.len);
+                s.busy.clear(std::memory_order_release);
+                if (msg.level >= _dump_level && msg.level != spdlog::level::off)
+                    dump("log level");
+            }
+
+            // 不需要刷新: 平时不写出
+            void flush() override { }
+            void set_pattern(const std::string &) override { }
+            void set_formatter(std::unique_ptr<spdlog::formatter>) override { }
+
+            // 把上次转储之后的记录追加写入文件，可以在信号处理函数中调用
+            // 另一个线程正在转储时直接返回 false
+            // 遇到正在写入 (或序号已分配还没写入) 的记录时停下，它和之后的记录留给下一次转储
+            bool dump(const char *reason) noexcept { return dump(reason, false); }
+
+            // 安装致命信号处理: 先转储再按原来的处理方式处理信号；同一时间只有一个记录器生效
+            void install_signal_handlers() {
+                flight_recorder *expected = nullptr;
+                if (!active().compare_exchange_strong(expected, this))
+                    return;
+                struct sigaction action;
+                std::memset(&action, 0, sizeof(action));
+                action.sa_handler = &flight_recorder::on_signal;
+                sigemptyset(&action.sa_mask);
+                for (std::size_t i = 0; i < signal_count; ++i)
+                    ::sigaction(fatal_signals[i], &action, &previous()[i]);
+            }
+
+            void uninstall_signal_handlers() {
+                flight_recorder *expected = this;
+                if (!active().compare_exchange_strong(expected, nullptr))
+                    return;
+                for (std::size_t i = 0; i < signal_count; ++i)
+                    ::sigaction(fatal_signals[i], &previous()[i], nullptr);
+            }
+
+        private:
+            static constexpr int fatal_signals[] = { SIGSEGV, SIGABRT, SIGBUS, SIGFPE, SIGILL };
+            static constexpr std::size_t signal_count = sizeof(fatal_signals) / sizeof(fatal_signals[0]);
+
+            static std::atomic<flight_recorder*>& active() {
+                static std::atomic<flight_recorder*> recorder{ nullptr };
+                return recorder;
+            }
+
+            static struct sigaction* previous() {
+                static struct sigaction actions[signal_count];
+                return actions;
+            }
+
+            // final 为 true (致命信号，之后不会再转储) 时跳过正在写入的记录，把其余的都写出
+            bool dump(const char *reason, bool final) noexcept {
+                if (_dumping.test_and_set(std::memory_order_acquire))
+                    return false;
+                int fd = ::open(_path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+                if (fd < 0) {
+                    _dumping.clear(std::memory_order_release);
+                    return false;
+                }
+                std::uint64_t end = _next.load(std::memory_order_acquire);
+                std::uint64_t begin = end > _mask + 1 ? end - _mask - 1 : 0;
+                if (begin < _dumped)
+                    begin = _dumped;
+                line_buffer out(fd);
+                out.put("==== flight recorder dump (").put(reason).put("), ").num(end - begin).put(" records ====\n");
+                std::uint64_t seq = begin;
+                for (; seq < end; ++seq) {
+                    slot &s = _slots[seq & _mask];
+                    if (s.busy.test_and_set(std::memory_order_acquire)) {
+                        if (final)
+                            continue;
+                        break;
+                    }
+                    std::uint64_t written = s.seq;
+                    if (written == seq + 1)
+                        format(out, s);
+                    s.busy.clear(std::memory_order_release);
+                    if (written < seq + 1 && !final)
+                        break;      // 序号已分配，写入方还没拿到槽位
+                    // written 更大时已被绕回的新记录覆盖，这条已经丢失
+                }
+                if (seq < end)
+                    out.put("==== ").num(end - seq).put(" records still being written, left for the next dump ====\n");
+                out.flush();
+                ::close(fd);
+                _dumped = seq;
+                _dumping.clear(std::memory_order_release);
+                return true;
+            }
+
+            static void on_signal(int sig) {
+                if (flight_recorder *recorder = active().load(std::memory_order_acquire)) {
+                    recorder->dump(sig == SIGABRT ? "SIGABRT" : sig == SIGSEGV ? "SIGSEGV" : "fatal signal", true);
+                    for (std::size_t i = 0; i < signal_count; ++i)
+                        if (fatal_signals[i] == sig)
+                            ::sigaction(sig, &previous()[i], nullptr);
+                } else {
+                    ::signal(sig, SIG_DFL);
+                }
+                ::raise(sig);   // 信号处理期间该信号被屏蔽，返回后按原来的处理方式再次处理
+            }
+
+            // 栈上的输出缓冲区，满了就 write，不分配内存
+            class line_buffer
+            {
+            public:
+                explicit line_buffer(int fd) : _fd(fd) { }
+
+                line_buffer& put(const char *s, std::size_t n) {
+                    while (n > 0) {
+                        if (_len == sizeof(_buf))
+                            flush();
+                        std::size_t chunk = std::min(n, sizeof(_buf) - _len);
+                        std::memcpy(_buf + _len, s, chunk);
+                        _len += chunk;
+                        s += chunk;
+                        n -= chunk;
+                    }
+                    return *this;
+                }
+
+                line_buffer& put(const char *s) { return put(s ? s : "", s ? std::strlen(s) : 0); }
+
+                // 十进制整数，width 大于位数时补 0
+                line_buffer& num(std::uint64_t v, int width = 0) {
+                    char digits[24];
+                    int n = 0;
+                    do {
+                        digits[n++] = static_cast<char>('0' + v % 10);
+                        v /= 10;
+                    } while (v > 0);
+                    while (n < width)
+                        digits[n++] = '0';
+                    char text[24];
+                    for (int i = 0; i < n; ++i)
+                        text[i] = digits[n - 1 - i];
+                    return put(text, static_cast<std::size_t>(n));
+                }
+
+                void flush() {
+                    std::size_t done = 0;
+                    while (done < _len) {
+                        ssize_t n = ::write(_fd, _buf + done, _len - done);
+                        if (n <= 0)
+                            break;
+                        done += static_cast<std::size_t>(n);
+                    }
+                    _len = 0;
+                }
+
+            private:
+                int _fd;
+                std::size_t _len = 0;
+                char _buf[4096];
+            };
+
+            // [2026-10-18 01:23:45.123456] [D] [thread 123] 消息 [file:line function]
+            void format(line_buffer &out, const slot &s) const {
+                std::int64_t secs = s.time / 1000000000 + _utc_offset;
+                std::int64_t days = secs >= 0 ? secs / 86400 : (secs - 86399) / 86400;
+                std::int64_t rem = secs - days * 86400;
+                // 公历日期 (Howard Hinnant civil_from_days)
+                std::int64_t z = days + 719468;
+                std::int64_t era = (z >= 0 ? z : z - 146096) / 146097;
+                std::int64_t doe = z - era * 146097;
+                std::int64_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+                std::int64_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+                std::int64_t mp = (5 * doy + 2) / 153;
+                std::int64_t day = doy - (153 * mp + 2) / 5 + 1;
+                std::int64_t month = mp < 10 ? mp + 3 : mp - 9;
+                std::int64_t year = yoe + era * 400 + (month <= 2);
+                const char *short_name = spdlog::level::to_short_c_str(s.level);
+                out.put("[").num(static_cast<std::uint64_t>(year)).put("-").num(month, 2).put("-").num(day, 2)
+                   .put(" ").num(rem / 3600, 2).put(":").num(rem / 60 % 60, 2).put(":").num(rem % 60, 2)
+                   .put(".").num(static_cast<std::uint64_t>(s.time % 1000000000 / 1000), 6)
+                   .put("] [").put(short_name).put("] [thread ").num(s.tid).put("] ")
+                   .put(s.text, s.len);
+                if (s.file)
+                    out.put(" [").put(s.file).put(":").num(static_cast<std::uint64_t>(s.line)).put(" ").put(s.func).put("]");
+                out.put("\n");
+            }
+
+            const std::string _path;
+            const spdlog::level::level_enum _dump_level;
+            std::unique_ptr<slot[]> _slots;
+            std::uint64_t _mask = 0;
+            long _utc_offset = 0;
+            alignas(64) std::atomic<std::uint64_t> _next{ 0 };     // 下一条记录的序号
+            std::atomic_flag _dumping = ATOMIC_FLAG_INIT;
+            std::uint64_t _dumped = 0;                          // 已转储到的序号，_dumping 保护
+        };
+
+    }  // log
+
+}  // utils
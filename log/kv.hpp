@@ -0,0 +1,278 @@
+#pragma once
+
+#include <spdlog/common.h>
+#include <spdlog/formatter.h>
+#include <spdlog/details/log_msg.h>
+#include <spdlog/details/os.h>
+#include <fmt/format.h>
+#include <string>
+#include <memory>
+#include <atomic>
+#include <chrono>
+#include <iterator>
+#include <cmath>
+#include <ctime>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <type_traits>
+
+namespace utils {
+
+    namespace log {
+
+        // 结构化日志格式: 日志文件每行一条 JSON 对象 (JSON lines) 或 logfmt (key=value ...)
+        enum class kv_format { none, logfmt, json };
+
+        namespace detail {
+
+            // 结构化日志 (L*_KV) 的 log_msg 使用这个 logger 名字，kv_formatter 据此知道 payload 已经是编码好的字段
+            constexpr spdlog::string_view_t kv_logger_name{ "kv", 2 };
+
+            // L*_KV 的字段编码为哪种格式，与日志文件的格式一致；没有结构化文件时用 logfmt，终端上也便于阅读
+            inline std::atomic<kv_format>& kv_encoding() {
+                static std::atomic<kv_format> encoding{ kv_format::logfmt };
+                return encoding;
+            }
+
+            inline void kv_append(spdlog::memory_buf_t &out, const char *s, std::size_t n) {
+                out.append(s, s + n);
+            }
+
+            inline void kv_append(spdlog::memory_buf_t &out, const char *s) {
+                kv_append(out, s, std::strlen(s));
+            }
+
+            // JSON 字符串，带引号
+            inline void kv_quote_json(spdlog::memory_buf_t &out, const char *s, std::size_t n) {
+                static const char hex[] = "0123456789abcdef";
+                out.push_back('"');
+                for (std::size_t i = 0; i < n; ++i) {
+                    unsigned char c = static_cast<unsigned char>(s[i]);
+                    switch (c) {
+                    case '"': kv_append(out, "\\\"", 2); break;
+                    case '\\': kv_append(out, "\\\\", 2); break;
+                    case '\n': kv_append(out, "\\n", 2); break;
+                    case '\r': kv_append(out, "\\r", 2); break;
+                    case '\t': kv_append(out, "\\t", 2); break;
+                    default:
+                        if (c < 0x20) {
+                            char esc[6] = { '\\', 'u', '0', '0', hex[c >> 4], hex[c & 0xf] };
+                            kv_append(out, esc, sizeof(esc));
+                        } else {
+                            out.push_back(static_cast<char>(c));
+                        }
+                    }
+                }
+                out.push_back('"');
+            }
+
+            // logfmt 值: 不含空格、引号、等号和控制字符时原样输出，否则加引号并转义
+            inline void kv_quote_logfmt(spdlog::memory_buf_t &out, const char *s, std::size_t n) {
+                bool plain = n > 0;
+                for (std::size_t i = 0; i < n && plain; ++i)
+                    plain = static_cast<unsigned char>(s[i]) > ' ' && s[i] != '"' && s[i] != '=' && s[i] != '\\';
+                if (plain) {
+                    kv_append(out, s, n);
+                    return;
+                }
+                out.push_back('"');
+                for (std::size_t i = 0; i < n; ++i) {
+                    char c = s[i];
+                    if (c == '"' || c == '\\')
+                        out.push_back('\\');
+                    if (c == '\n')
+                        kv_append(out, "\\n", 2);
+                    else
+                        out.push_back(c);
+                }
+                out.push_back('"');
+            }
+
+            inline void kv_quote(spdlog::memory_buf_t &out, kv_format format, const char *s, std::size_t n) {
+                if (format == kv_format::json)
+                    kv_quote_json(out, s, n);
+                else
+                    kv_quote_logfmt(out, s, n);
+            }
+
+            // 字段名: 要求是标识符一类的字面量，不转义
+            inline void kv_key(spdlog::memory_buf_t &out, kv_format format, const char *key) {
+                if (format == kv_format::json) {
+                    kv_append(out, ",\"", 2);
+                    kv_append(out, key);
+                    kv_append(out, "\":", 2);
+                } else {
+                    out.push_back(' ');
+                    kv_append(out, key);
+                    out.push_back('=');
+                }
+            }
+
+            // 字段值按类型直接写入: 整数、浮点、布尔不加引号，字符串按格式转义，其他类型用 fmt 格式化后按字符串处理
+            template<class T>
+            void kv_value(spdlog::memory_buf_t &out, kv_format format, const T &value) {
+                using type = std::decay_t<T>;
+                if constexpr (std::is_same<type, bool>::value) {
+                    kv_append(out, value ? "true" : "false");
+                } else if constexpr (std::is_same<type, char>::value) {
+                    kv_quote(out, format, &value, 1);
+                } else if constexpr (std::is_enum<type>::value) {
+                    fmt::format_to(std::back_inserter(out), "{}", static_cast<std::underlying_type_t<type>>(value));
+                } else if constexpr (std::is_integral<type>::value) {
+                    fmt::format_to(std::back_inserter(out), "{}", value);
+                } else if constexpr (std::is_floating_point<type>::value) {
+                    if (std::isfinite(value))
+                        fmt::format_to(std::back_inserter(out), "{}", value);
+                    else
+                        kv_append(out, format == kv_format::json ? "null" : "NaN");
+                } else if constexpr (std::is_same<type, std::nullptr_t>::value) {
+                    kv_append(out, "null");
+                } else if constexpr (std::is_pointer<T>::value && std::is_convertible<T, const char*>::value) {
+                    const char *s = value ? value : "";
+                    kv_quote(out, format, s, std::strlen(s));
+                } else if constexpr (std::is_convertible<const T&, spdlog::string_view_t>::value) {
+                    spdlog::string_view_t s = value;
+                    kv_quote(out, format, s.data(), s.size());
+                } else {
+                    spdlog::memory_buf_t text;
+                    fmt::format_to(std::back_inserter(text), "{}", value);
+                    kv_quote(out, format, text.data(), text.size());
+                }
+            }
+
+            inline void kv_fields(spdlog::memory_buf_t &, kv_format) { }
+
+            template<class V, class... Rest>
+            void kv_fields(spdlog::memory_buf_t &out, kv_format format, const char *key, const V &value, const Rest&... rest) {
+                kv_key(out, format, key);
+                kv_value(out, format, value);
+                kv_fields(out, format, rest...);
+            }
+
+            // 调用点信息，由 L*_KV 定义为函数内 static，只在第一次经过时构造
+            // event 和源码位置预先编码成两种格式的字段前缀，之后每次只需复制
+            class kv_site
+            {
+            public:
+                kv_site(const char *event, const char *file, int line, const char *function)
+                    : _file(basename(file)), _func(short_function(function)) {
+                    loc = spdlog::source_loc{ _file.c_str(), line, _func.c_str() };
+                    std::string src = _file + ":" + std::to_string(line) + " " + _func;
+                    spdlog::memory_buf_t buf;
+                    kv_append(buf, "\"event\":");
+                    kv_quote_json(buf, event, std::strlen(event));
+                    kv_append(buf, ",\"src\":");
+                    kv_quote_json(buf, src.data(), src.size());
+                    _json.assign(buf.data(), buf.size());
+                    buf.clear();
+                    kv_append(buf, "event=");
+                    kv_quote_logfmt(buf, event, std::strlen(event));
+                    kv_append(buf, " src=");
+                    kv_quote_logfmt(buf, src.data(), src.size());
+                    _logfmt.assign(buf.data(), buf.size());
+                }
+
+                kv_site(const kv_site&) = delete;
+                kv_site& operator=(const kv_site&) = delete;
+
+                const std::string& prefix(kv_format format) const { return format == kv_format::json ? _json : _logfmt; }
+
+                spdlog::source_loc loc;         // 文件名和函数名指向下面的字符串
+
+            private:
+                static std::string basename(const char *file) {
+                    const char *slash = std::strrchr(file, '/');
+                    return slash ? slash + 1 : file;
+                }
+
+                // __PRETTY_FUNCTION__ 去掉返回类型和参数: "void utils::rpc::client::call(int)" -> "utils::rpc::client::call"
+                static std::string short_function(const char *function) {
+                    std::string name = function;
+                    std::size_t paren = name.find('(');
+                    if (paren != std::string::npos)
+                        name.resize(paren);
+                    std::size_t space = name.rfind(' ');
+                    if (space != std::string::npos)
+                        name.erase(0, space + 1);
+                    return name;
+                }
+
+                const std::string _file;
+                const std::string _func;
+                std::string _json;
+                std::string _logfmt;
+            };
+
+        }  // detail
+
+        // 日志文件的结构化格式化器，替换 sink 上的 pattern_formatter
+        //     {"ts":"2026-10-18T01:23:45.123456+08:00","level":"info","tid":123,"event":"rpc.reply","src":"...","method":"echo"}
+        //     ts=2026-10-18T01:23:45.123456+08:00 level=info tid=123 event=rpc.reply src=... method=echo
+        // L*_KV 的字段已经编码好，原样写入；普通日志写成 src 和 msg 两个字段
+        class kv_formatter : public spdlog::formatter
+        {
+        public:
+            explicit kv_formatter(kv_format format) : _format(format == kv_format::json ? kv_format::json : kv_format::logfmt) { }
+
+            void format(const spdlog::details::log_msg &msg, spdlog::memory_buf_t &dest) override {
+                using namespace detail;
+                bool json = _format == kv_format::json;
+                kv_append(dest, json ? "{\"ts\":\"" : "ts=");
+                timestamp(dest, msg.time);
+                kv_append(dest, json ? "\",\"level\":\"" : " level=");
+                auto level = spdlog::level::to_string_view(msg.level);
+                kv_append(dest, level.data(), level.size());
+                kv_append(dest, json ? "\",\"tid\":" : " tid=");
+                fmt::format_to(std::back_inserter(dest), "{}", msg.thread_id);
+                if (msg.logger_name == kv_logger_name) {
+                    dest.push_back(json ? ',' : ' ');
+                    kv_append(dest, msg.payload.data(), msg.payload.size());
+                } else {
+                    if (!msg.source.empty()) {
+                        const char *file = std::strrchr(msg.source.filename, '/');
+                        file = file ? file + 1 : msg.source.filename;
+                        spdlog::memory_buf_t src;
+                        fmt::format_to(std::back_inserter(src), "{}:{}", file, msg.source.line);
+                        kv_key(dest, _format, "src");
+                        kv_quote(dest, _format, src.data(), src.size());
+                    }
+                    kv_key(dest, _format, "msg");
+                    kv_quote(dest, _format, msg.payload.data(), msg.payload.size());
+                }
+                if (json)
+                    dest.push_back('}');
+                kv_append(dest, spdlog::details::os::default_eol, std::strlen(spdlog::details::os::default_eol));
+            }
+
+            std::unique_ptr<spdlog::formatter> clone() const override {
+                return std::unique_ptr<spdlog::formatter>(new kv_formatter(_format));
+            }
+
+        private:
+            // 本地时间 RFC 3339，精确到微秒；秒以上的部分每秒只格式化一次
+            void timestamp(spdlog::memory_buf_t &dest, spdlog::log_clock::time_point time) {
+                auto since = time.time_since_epoch();
+                auto secs = std::chrono::duration_cast<std::chrono::seconds>(since);
+                if (secs.count() != _cached_sec) {
+                    std::time_t t = static_cast<std::time_t>(secs.count());
+                    std::tm local;
+                    ::localtime_r(&t, &local);
+                    std::strftime(_date, sizeof(_date), "%Y-%m-%dT%H:%M:%S", &local);
+                    long off = std::labs(local.tm_gmtoff / 60) % (24 * 60);
+                    *fmt::format_to_n(_zone, sizeof(_zone) - 1, "{}{:02}:{:02}", local.tm_gmtoff < 0 ? '-' : '+', off / 60, off % 60).out = '\0';
+                    _cached_sec = secs.count();
+                }
+                auto micros = std::chrono::duration_cast<std::chrono::microseconds>(since - secs).count();
+                fmt::format_to(std::back_inserter(dest), "{}.{:06}{}", _date, micros, _zone);
+            }
+
+            const kv_format _format;
+            std::int64_t _cached_sec = -1;
+            char _date[32] = {};
+            char _zone[16] = {};
+        };
+
+    }  // log
+
+}  // utils
@@ -1,22 +1,80 @@
 #pragma once
 
 #define SPDLOG_FUNCTION __PRETTY_FUNCTION__
+// 编译期全局下限，低于它的 L* 调用被去掉；可在编译选项中覆盖，例如 -DSPDLOG_ACTIVE_LEVEL=SPDLOG_LEVEL_INFO
+#ifndef SPDLOG_ACTIVE_LEVEL
 #define SPDLOG_ACTIVE_LEVEL SPDLOG_LEVEL_DEBUG
+#endif
 #include <spdlog/spdlog.h>
 #include <spdlog/sinks/stdout_color_sinks.h>
 #include <spdlog/sinks/rotating_file_sink.h>
 #include <cstdarg>
+#include <cstdio>
+#include <string>
+#include <chrono>
+#include <iterator>
+#include <algorithm>
 #include <unistd.h>
 #include <sys/stat.h>
 
+#include "async_sink.hpp"
+#include "binary_log.hpp"
+#include "category.hpp"
+#include "flight_recorder.hpp"
+#include "mmap_sink.hpp"
+#include "archive.hpp"
+#include "rate_limit.hpp"
+#include "kv.hpp"
+#include "pattern.hpp"
+
+// 定义为 1 时编译期固定使用二进制日志 (binary_log.hpp)，logger 忽略 logger_options::binary
+#ifndef LOGGER_BINARY
+#define LOGGER_BINARY 0
+#endif
+
 namespace utils {
 
     namespace log {
 
+        struct logger_options
+        {
+            std::string filename;
+            size_t max_file_size = 10 * 1024 * 1024;
+            size_t max_files = 3;
+            // 日志文件用预分配的 mmap 段 (mmap_sink.hpp)，切换文件不阻塞写日志的线程
+            bool mmap = false;
+            // 归档 (archive.hpp): 写满的文件改名为 app.<时间>.log，由后台低优先级线程压缩为 .gz，
+            // 按总大小和保留时间删除最旧的归档；启用后不再使用 max_files
+            bool archive = false;
+            bool compress = true;
+            size_t max_total_size = 0;              // 归档文件总大小上限 (字节)，0 为不限
+            std::chrono::seconds max_age{ 0 };      // 归档文件最长保留时间，0 为不限
+            // 日志文件写成 JSON lines 或 logfmt (kv.hpp)，终端仍为文本；L*_KV 的字段按类型直接写入
+            kv_format structured = kv_format::none;
+            // 异步模式: 调用线程只格式化并入队，由后台线程写终端和文件
+            bool async = false;
+            size_t queue_size = 8192;               // 队列条数，向上取整到 2 的幂
+            unsigned writer_threads = 1;            // 多于 1 个时日志之间不保证顺序
+            overflow_policy overflow = overflow_policy::block;
+            // 二进制模式: LTRACE...LFATAL 只记录参数原始字节，用 log/decoder 离线还原成文本
+            bool binary = LOGGER_BINARY;
+            std::string binary_file;                // 默认为 filename + ".bin"
+            // 飞行记录器: 在内存中保留最近的 debug/trace 日志，error 及以上、致命信号或 dump_flight_recorder() 时写出
+            bool flight_recorder = false;
+            size_t flight_records = 4096;           // 保留的条数
+            std::string flight_file;                // 默认为 filename + ".flight"
+        };
+
         class logger
         {
         public:
-            logger(const char *filename, size_t max_file_size, size_t max_files) {
+            logger(const char *filename, size_t max_file_size, size_t max_files)
+                : logger(make_options(filename, max_file_size, max_files)) { }
+
+            explicit logger(const logger_options &opts) {
+                const char *filename = opts.filename.c_str();
+                size_t max_file_size = opts.max_file_size;
+                size_t max_files = opts.max_files;
                 mkdirs (filename); // 检查并创建不存在目录
                 auto stdout_sink = std::make_shared<spdlog::sinks::stdout_color_sink_mt >();
                 // 设置打印级别
@@ -27,26 +85,100 @@ namespace utils {
                 stdout_sink->set_level(spdlog::level::warn);
 #endif
 
-                auto rotating_sink = std::make_shared<spdlog::sinks::rotating_file_sink_mt>(filename, max_file_size, max_files);
+                std::shared_ptr<archiver> retention;
+                if (opts.archive) {
+                    archive_policy policy;
+                    policy.compress = opts.compress;
+                    policy.max_total_size = opts.max_total_size;
+                    policy.max_age = opts.max_age;
+                    retention = std::make_shared<archiver>(opts.filename, policy);
+                }
+                spdlog::sink_ptr rotating_sink;
+                if (opts.mmap)
+                    rotating_sink = std::make_shared<mmap_file_sink>(filename, max_file_size, max_files, retention);
+                else if (retention)
+                    rotating_sink = std::make_shared<archiving_file_sink>(filename, max_file_size, retention);
+                else
+                    rotating_sink = std::make_shared<spdlog::sinks::rotating_file_sink_mt>(filename, max_file_size, max_files);
                 // 设置打印级别
                 rotating_sink->set_level(spdlog::level::debug);
                 std::vector<spdlog::sink_ptr> sinks {stdout_sink, rotating_sink};
-                auto my_logger = std::make_shared<spdlog::logger>("loggername", sinks.begin(), sinks.end());
 #ifdef DEBUG
-                my_logger->flush_on(spdlog::level::debug);
+                auto flush_level = spdlog::level::debug;
 #else
                 // 当发出 warn 或更严重的错误时立刻刷新到日志
-                my_logger->flush_on(spdlog::level::warn);
+                auto flush_level = spdlog::level::warn;
 #endif
+                if (opts.async) {
+                    // 刷新交给写线程，调用线程不等待
+                    _async = std::make_shared<async_sink>(sinks, opts.queue_size, opts.overflow, opts.writer_threads, flush_level);
+                    sinks = {_async};
+                }
+                if (opts.flight_recorder) {
+                    // 记录器要收到所有级别，logger 放开到 trace；其他 sink 至少 info，与原来 logger 的默认级别一致，不多写文件
+                    for (auto &sink : sinks)
+                        sink->set_level(std::max(sink->level(), spdlog::level::info));
+                    _recorder = std::make_shared<flight_recorder>(opts.flight_file.empty() ? opts.filename + ".flight" : opts.flight_file,
+                                                                  opts.flight_records);
+                    _recorder->install_signal_handlers();
+                    sinks.push_back(_recorder);
+                }
+                auto my_logger = std::make_shared<spdlog::logger>("loggername", sinks.begin(), sinks.end());
+                my_logger->flush_on(opts.async ? spdlog::level::off : flush_level);
+                if (_recorder)
+                    my_logger->set_level(spdlog::level::trace);
                 spdlog::register_logger(my_logger);
                 spdlog::set_default_logger(my_logger);
-                spdlog::set_pattern("[%H:%M:%S] [%^---%L---%$] [%v]\n[%C-%m-%d] [thread %t] [%s:%!:%#]");
+                spdlog::set_pattern(default_pattern);
+                if (opts.structured != kv_format::none)
+                    rotating_sink->set_formatter(std::unique_ptr<spdlog::formatter>(new kv_formatter(opts.structured)));
+                detail::kv_encoding().store(opts.structured == kv_format::json ? kv_format::json : kv_format::logfmt,
+                                            std::memory_order_relaxed);
+                if (opts.binary || LOGGER_BINARY) {
+                    binary::backend::instance().start(opts.binary_file.empty() ? opts.filename + ".bin" : opts.binary_file);
+                    binary::enabled_flag().store(true, std::memory_order_relaxed);
+                    _binary = true;
+                }
             }
             virtual ~logger() {
+                detail::report_suppressed(spdlog::default_logger_raw());
+                if (_binary) {
+                    binary::enabled_flag().store(false, std::memory_order_relaxed);
+                    binary::backend::instance().stop();
+                }
+                if (_recorder)
+                    _recorder->uninstall_signal_handlers();
+                if (_async)
+                    _async->stop();     // 写出队列中剩余的日志
                 spdlog::drop_all();
             }
 
+            // 报告限流日志中还没汇总的抑制条数，再刷新所有 sink
+            void flush() {
+                auto *logger = spdlog::default_logger_raw();
+                detail::report_suppressed(logger);
+                logger->flush();
+            }
+
+            // 把飞行记录器中上次写出之后的日志追加写入文件，未启用时返回 false
+            bool dump_flight_recorder(const char *reason = "on demand") {
+                return _recorder && _recorder->dump(reason);
+            }
+
+            // 异步模式下因队列满被丢弃的日志条数，同步模式总是 0
+            size_t dropped() const {
+                return (_async ? _async->dropped() : 0) + (_binary ? binary::backend::instance().dropped() : 0);
+            }
+
         private:
+            static logger_options make_options(const char *filename, size_t max_file_size, size_t max_files) {
+                logger_options opts;
+                opts.filename = filename;
+                opts.max_file_size = max_file_size;
+                opts.max_files = max_files;
+                return opts;
+            }
+
             inline void mkdirs(const char *muldir) {
                 char buf[4096] = {0};
                 strncpy(buf, muldir, 2096);
@@ -59,39 +191,265 @@ namespace utils {
                     }
                 }
             }
+
+            std::shared_ptr<async_sink> _async;
+            std::shared_ptr<flight_recorder> _recorder;
+            bool _binary = false;
         };
 
     }  // log
 
 }  // utils
 
-// 这段代码的目的实际上是为了去掉编译告警 [-Wformat-extra-args]
-inline void logger_fmt(char *out, size_t size, const char *fmt, ...)
-{
-    va_list args;
-    va_start (args, fmt);
-    vsnprintf(out, size, fmt, args);
-    va_end (args);
-}
+namespace utils {
+
+    namespace log {
+
+        namespace detail {
+            // 格式串中有 % 时按 printf 风格处理，否则按 spdlog {} 风格；在编译期对字面量求值
+            constexpr bool is_printf(const char *fmt) {
+                for (; *fmt; ++fmt)
+                    if (*fmt == '%')
+                        return true;
+                return false;
+            }
+
+            // 绕过 logger 的级别直接写 sink，级别已由调用者判断
+            inline void dispatch(spdlog::logger *logger, const spdlog::details::log_msg &msg) {
+                try {
+                    for (auto &sink : logger->sinks())
+                        if (sink->should_log(msg.level))
+                            sink->log(msg);
+                    if (msg.level >= logger->flush_level() && msg.level != spdlog::level::off)
+                        logger->flush();
+                } catch (const std::exception &) {
+                    // 与 spdlog 一致，写日志失败不影响调用者
+                }
+            }
+
+            // 交给 logger 输出；direct 为 true 时 (分类日志，级别已由分类判断) 绕过 logger 的级别直接写 sink
+            inline void submit(spdlog::logger *logger, bool direct, const spdlog::source_loc &loc,
+                               spdlog::level::level_enum level, spdlog::string_view_t payload) {
+                if (!direct) {
+                    logger->log(loc, level, payload);
+                    return;
+                }
+                dispatch(logger, spdlog::details::log_msg(loc, logger->name(), level, payload));
+            }
+
+            // {} 风格: 格式串在编译期检查
+            template<class... Args>
+            void log_format(spdlog::logger *logger, bool direct, const spdlog::source_loc &loc,
+                            spdlog::level::level_enum level, fmt::format_string<Args...> fmt, Args&&... args) {
+                if (!direct) {
+                    logger->log(loc, level, fmt, std::forward<Args>(args)...);
+                    return;
+                }
+                spdlog::memory_buf_t buf;
+                fmt::vformat_to(std::back_inserter(buf), fmt, fmt::make_format_args(args...));
+                submit(logger, direct, loc, level, spdlog::string_view_t(buf.data(), buf.size()));
+            }
+
+            // printf 风格: 直接格式化到 spdlog 的内存缓冲区 (栈上 250 字节，不够时扩容)，不截断，spdlog 不再二次格式化
+            // 不加 format 属性，{} 风格的调用也会编译这一分支，加了会产生 -Wformat-extra-args 告警
+            inline void log_printf(spdlog::logger *logger, bool direct, const spdlog::source_loc &loc,
+                                   spdlog::level::level_enum level, const char *fmt, ...) {
+                spdlog::memory_buf_t buf;
+                buf.resize(buf.capacity());
+                va_list args, retry;
+                va_start (args, fmt);
+                va_copy (retry, args);
+                int n = vsnprintf(buf.data(), buf.size(), fmt, args);
+                va_end (args);
+                if (n >= 0 && static_cast<size_t>(n) >= buf.size()) {
+                    buf.resize(static_cast<size_t>(n) + 1);
+                    n = vsnprintf(buf.data(), buf.size(), fmt, retry);
+                }
+                va_end (retry);
+                if (n < 0)
+                    return;
+                submit(logger, direct, loc, level, spdlog::string_view_t(buf.data(), static_cast<size_t>(n)));
+            }
+
+            // 结构化日志: 调用点前缀 (event、src) 加上按类型编码的字段，直接写入 spdlog 的内存缓冲区
+            template<class... Args>
+            void log_kv(spdlog::logger *logger, const kv_site &site, spdlog::level::level_enum level, const Args&... args) {
+                static_assert(sizeof...(Args) % 2 == 0, "L*_KV expects key/value pairs");
+                kv_format format = kv_encoding().load(std::memory_order_relaxed);
+                const std::string &prefix = site.prefix(format);
+                spdlog::memory_buf_t buf;
+                buf.append(prefix.data(), prefix.data() + prefix.size());
+                kv_fields(buf, format, args...);
+                dispatch(logger, spdlog::details::log_msg(site.loc, kv_logger_name, level, spdlog::string_view_t(buf.data(), buf.size())));
+            }
+        }  // detail
+
+    }  // log
+
+}  // utils
 
 // 支持传统 %s 控制符输出，还支持spdlog {} 条件控制输出，无缝替换
-#define LOGGER_CALL(logger, fmt, ...)                             \
-    {                                                             \
-        if (strchr(fmt, '%')) {                                   \
-            char temp[2048] = {0};                                \
-            logger_fmt (temp, sizeof(temp), fmt, ##__VA_ARGS__);  \
-            logger (temp);                                        \
-        } else {                                                  \
-            logger (fmt, ##__VA_ARGS__);                          \
-        }                                                         \
+// 风格在编译期确定，fmt 必须是字符串字面量；级别未开启时不会对参数求值
+// 二进制模式下只写入调用点编号和参数，格式化推迟到 log/decoder
+#define LOGGER_EMIT(logger, direct, level, fmt, ...)                                              \
+    if (LOGGER_BINARY || utils::log::binary::enabled()) {                                         \
+        static utils::log::binary::site site_{level, fmt, __FILE__, __LINE__, SPDLOG_FUNCTION};   \
+        utils::log::binary::write(site_, ##__VA_ARGS__);                                          \
+    } else {                                                                                      \
+        spdlog::source_loc loc_{__FILE__, __LINE__, SPDLOG_FUNCTION};                             \
+        if constexpr (utils::log::detail::is_printf(fmt))                                         \
+            utils::log::detail::log_printf(logger, direct, loc_, level, fmt, ##__VA_ARGS__);      \
+        else                                                                                      \
+            utils::log::detail::log_format(logger, direct, loc_, level, fmt, ##__VA_ARGS__);      \
     }
 
-#define LTRACE(fmt, ...) LOGGER_CALL(SPDLOG_TRACE, fmt, ##__VA_ARGS__)
-#define LDEBUG(fmt, ...) LOGGER_CALL(SPDLOG_DEBUG, fmt, ##__VA_ARGS__)
-#define LINFO(fmt, ...) LOGGER_CALL(SPDLOG_INFO, fmt, ##__VA_ARGS__)
-#define LWARN(fmt, ...) LOGGER_CALL(SPDLOG_WARN, fmt, ##__VA_ARGS__)
-#define LERROR(fmt, ...) LOGGER_CALL(SPDLOG_ERROR, fmt, ##__VA_ARGS__)
-#define LFATAL(fmt, ...) LOGGER_CALL(SPDLOG_CRITICAL, fmt, ##__VA_ARGS__)
+#define LOGGER_CALL(level, fmt, ...)                                                              \
+    do {                                                                                          \
+        auto *logger_ = spdlog::default_logger_raw();                                             \
+        if (logger_->should_log(level)) {                                                         \
+            LOGGER_EMIT(logger_, false, level, fmt, ##__VA_ARGS__)                                \
+        }                                                                                         \
+    } while (0)
+
+// 分类日志: 先按分类的编译期下限去掉，再用分类的运行时级别判断 (一次 relaxed 读)，不看 logger 的级别
+#define LOGGER_CATEGORY_CALL(cat, level_num, level, fmt, ...)                                     \
+    do {                                                                                          \
+        if constexpr (level_num >= std::decay<decltype(utils::log::categories::cat)>::type::floor) { \
+            if (utils::log::categories::cat.should_log(level)) {                                  \
+                auto *logger_ = spdlog::default_logger_raw();                                     \
+                LOGGER_EMIT(logger_, true, level, fmt, ##__VA_ARGS__)                             \
+            }                                                                                     \
+        }                                                                                         \
+    } while (0)
+
+// 低于 SPDLOG_ACTIVE_LEVEL 的级别在编译期去掉
+#if SPDLOG_ACTIVE_LEVEL <= SPDLOG_LEVEL_TRACE
+#define LTRACE(fmt, ...) LOGGER_CALL(spdlog::level::trace, fmt, ##__VA_ARGS__)
+#else
+#define LTRACE(fmt, ...) (void)0
+#endif
+#if SPDLOG_ACTIVE_LEVEL <= SPDLOG_LEVEL_DEBUG
+#define LDEBUG(fmt, ...) LOGGER_CALL(spdlog::level::debug, fmt, ##__VA_ARGS__)
+#else
+#define LDEBUG(fmt, ...) (void)0
+#endif
+#if SPDLOG_ACTIVE_LEVEL <= SPDLOG_LEVEL_INFO
+#define LINFO(fmt, ...) LOGGER_CALL(spdlog::level::info, fmt, ##__VA_ARGS__)
+#else
+#define LINFO(fmt, ...) (void)0
+#endif
+#if SPDLOG_ACTIVE_LEVEL <= SPDLOG_LEVEL_WARN
+#define LWARN(fmt, ...) LOGGER_CALL(spdlog::level::warn, fmt, ##__VA_ARGS__)
+#else
+#define LWARN(fmt, ...) (void)0
+#endif
+#if SPDLOG_ACTIVE_LEVEL <= SPDLOG_LEVEL_ERROR
+#define LERROR(fmt, ...) LOGGER_CALL(spdlog::level::err, fmt, ##__VA_ARGS__)
+#else
+#define LERROR(fmt, ...) (void)0
+#endif
+#if SPDLOG_ACTIVE_LEVEL <= SPDLOG_LEVEL_CRITICAL
+#define LFATAL(fmt, ...) LOGGER_CALL(spdlog::level::critical, fmt, ##__VA_ARGS__)
+#else
+#define LFATAL(fmt, ...) (void)0
+#endif
+
+#define LCTRACE(cat, fmt, ...) LOGGER_CATEGORY_CALL(cat, SPDLOG_LEVEL_TRACE, spdlog::level::trace, fmt, ##__VA_ARGS__)
+#define LCDEBUG(cat, fmt, ...) LOGGER_CATEGORY_CALL(cat, SPDLOG_LEVEL_DEBUG, spdlog::level::debug, fmt, ##__VA_ARGS__)
+#define LCINFO(cat, fmt, ...) LOGGER_CATEGORY_CALL(cat, SPDLOG_LEVEL_INFO, spdlog::level::info, fmt, ##__VA_ARGS__)
+#define LCWARN(cat, fmt, ...) LOGGER_CATEGORY_CALL(cat, SPDLOG_LEVEL_WARN, spdlog::level::warn, fmt, ##__VA_ARGS__)
+#define LCERROR(cat, fmt, ...) LOGGER_CATEGORY_CALL(cat, SPDLOG_LEVEL_ERROR, spdlog::level::err, fmt, ##__VA_ARGS__)
+#define LCFATAL(cat, fmt, ...) LOGGER_CATEGORY_CALL(cat, SPDLOG_LEVEL_CRITICAL, spdlog::level::critical, fmt, ##__VA_ARGS__)
+
+// 限流与采样，用于热循环中的错误路径: 状态按调用点保存 (函数内 static)，判断只用原子操作，被抑制的调用不对参数求值
+//     LWARN_EVERY_N(n, ...)     第 1、n+1、2n+1 ... 次输出
+//     LWARN_EVERY_MS(ms, ...)   每 ms 毫秒最多输出一次
+//     LDEBUG_SAMPLED(p, ...)    以概率 p 输出
+//     LWARN_FIRST_N(n, ...)     只输出前 n 次
+// 被抑制的条数以 "N similar messages suppressed" 一行汇总，级别和源码位置与原日志相同:
+// 调用点下一次输出前报告 (每个调用点最多每秒一行)，其余在 logger::flush() 和 logger 析构时报告；
+// FIRST_N 超出 n 之后不再输出，被抑制的总数在 flush 或析构时一次报告
+#define LOGGER_LIMITED_CALL(level_num, level, mode, fmt, ...)                                     \
+    do {                                                                                          \
+        if constexpr (level_num >= SPDLOG_ACTIVE_LEVEL) {                                         \
+            auto *logger_ = spdlog::default_logger_raw();                                         \
+            if (logger_->should_log(level)) {                                                     \
+                static utils::log::detail::rate_site limit_{level, __FILE__, __LINE__, SPDLOG_FUNCTION}; \
+                if (limit_.mode) {                                                                \
+                    if (auto dropped_ = limit_.take_suppressed()) {                               \
+                        LOGGER_EMIT(logger_, false, level, "{} similar messages suppressed", dropped_) \
+                    }                                                                             \
+                    LOGGER_EMIT(logger_, false, level, fmt, ##__VA_ARGS__)                        \
+                }                                                                                 \
+            }                                                                                     \
+        }                                                                                         \
+    } while (0)
+
+#define LTRACE_EVERY_N(n, fmt, ...) LOGGER_LIMITED_CALL(SPDLOG_LEVEL_TRACE, spdlog::level::trace, every_n(n), fmt, ##__VA_ARGS__)
+#define LDEBUG_EVERY_N(n, fmt, ...) LOGGER_LIMITED_CALL(SPDLOG_LEVEL_DEBUG, spdlog::level::debug, every_n(n), fmt, ##__VA_ARGS__)
+#define LINFO_EVERY_N(n, fmt, ...) LOGGER_LIMITED_CALL(SPDLOG_LEVEL_INFO, spdlog::level::info, every_n(n), fmt, ##__VA_ARGS__)
+#define LWARN_EVERY_N(n, fmt, ...) LOGGER_LIMITED_CALL(SPDLOG_LEVEL_WARN, spdlog::level::warn, every_n(n), fmt, ##__VA_ARGS__)
+#define LERROR_EVERY_N(n, fmt, ...) LOGGER_LIMITED_CALL(SPDLOG_LEVEL_ERROR, spdlog::level::err, every_n(n), fmt, ##__VA_ARGS__)
+#define LFATAL_EVERY_N(n, fmt, ...) LOGGER_LIMITED_CALL(SPDLOG_LEVEL_CRITICAL, spdlog::level::critical, every_n(n), fmt, ##__VA_ARGS__)
+
+#define LTRACE_EVERY_MS(ms, fmt, ...) LOGGER_LIMITED_CALL(SPDLOG_LEVEL_TRACE, spdlog::level::trace, every_ms(ms), fmt, ##__VA_ARGS__)
+#define LDEBUG_EVERY_MS(ms, fmt, ...) LOGGER_LIMITED_CALL(SPDLOG_LEVEL_DEBUG, spdlog::level::debug, every_ms(ms), fmt, ##__VA_ARGS__)
+#define LINFO_EVERY_MS(ms, fmt, ...) LOGGER_LIMITED_CALL(SPDLOG_LEVEL_INFO, spdlog::level::info, every_ms(ms), fmt, ##__VA_ARGS__)
+#define LWARN_EVERY_MS(ms, fmt, ...) LOGGER_LIMITED_CALL(SPDLOG_LEVEL_WARN, spdlog::level::warn, every_ms(ms), fmt, ##__VA_ARGS__)
+#define LERROR_EVERY_MS(ms, fmt, ...) LOGGER_LIMITED_CALL(SPDLOG_LEVEL_ERROR, spdlog::level::err, every_ms(ms), fmt, ##__VA_ARGS__)
+#define LFATAL_EVERY_MS(ms, fmt, ...) LOGGER_LIMITED_CALL(SPDLOG_LEVEL_CRITICAL, spdlog::level::critical, every_ms(ms), fmt, ##__VA_ARGS__)
+
+#define LTRACE_SAMPLED(p, fmt, ...) LOGGER_LIMITED_CALL(SPDLOG_LEVEL_TRACE, spdlog::level::trace, sampled(p), fmt, ##__VA_ARGS__)
+#define LDEBUG_SAMPLED(p, fmt, ...) LOGGER_LIMITED_CALL(SPDLOG_LEVEL_DEBUG, spdlog::level::debug, sampled(p), fmt, ##__VA_ARGS__)
+#define LINFO_SAMPLED(p, fmt, ...) LOGGER_LIMITED_CALL(SPDLOG_LEVEL_INFO, spdlog::level::info, sampled(p), fmt, ##__VA_ARGS__)
+#define LWARN_SAMPLED(p, fmt, ...) LOGGER_LIMITED_CALL(SPDLOG_LEVEL_WARN, spdlog::level::warn, sampled(p), fmt, ##__VA_ARGS__)
+#define LERROR_SAMPLED(p, fmt, ...) LOGGER_LIMITED_CALL(SPDLOG_LEVEL_ERROR, spdlog::level::err, sampled(p), fmt, ##__VA_ARGS__)
+#define LFATAL_SAMPLED(p, fmt, ...) LOGGER_LIMITED_CALL(SPDLOG_LEVEL_CRITICAL, spdlog::level::critical, sampled(p), fmt, ##__VA_ARGS__)
+
+#define LTRACE_FIRST_N(n, fmt, ...) LOGGER_LIMITED_CALL(SPDLOG_LEVEL_TRACE, spdlog::level::trace, first_n(n), fmt, ##__VA_ARGS__)
+#define LDEBUG_FIRST_N(n, fmt, ...) LOGGER_LIMITED_CALL(SPDLOG_LEVEL_DEBUG, spdlog::level::debug, first_n(n), fmt, ##__VA_ARGS__)
+#define LINFO_FIRST_N(n, fmt, ...) LOGGER_LIMITED_CALL(SPDLOG_LEVEL_INFO, spdlog::level::info, first_n(n), fmt, ##__VA_ARGS__)
+#define LWARN_FIRST_N(n, fmt, ...) LOGGER_LIMITED_CALL(SPDLOG_LEVEL_WARN, spdlog::level::warn, first_n(n), fmt, ##__VA_ARGS__)
+#define LERROR_FIRST_N(n, fmt, ...) LOGGER_LIMITED_CALL(SPDLOG_LEVEL_ERROR, spdlog::level::err, first_n(n), fmt, ##__VA_ARGS__)
+#define LFATAL_FIRST_N(n, fmt, ...) LOGGER_LIMITED_CALL(SPDLOG_LEVEL_CRITICAL, spdlog::level::critical, first_n(n), fmt, ##__VA_ARGS__)
+
+// 结构化日志: 事件名加若干 key/value，字段按类型直接编码，不经过格式串
+//     LINFO_KV("rpc.reply", "method", m, "bytes", n, "us", t);
+// 日志文件为 JSON lines 或 logfmt (logger_options::structured) 时每个字段单独成为一列；文本 sink 中显示为 logfmt
+// 源码位置在调用点第一次经过时处理一次 (文件名去掉目录，函数名去掉返回类型和参数)，之后每次只复制
+#define LOGGER_KV_CALL(level_num, level, event, ...)                                              \
+    do {                                                                                          \
+        if constexpr (level_num >= SPDLOG_ACTIVE_LEVEL) {                                         \
+            auto *logger_ = spdlog::default_logger_raw();                                         \
+            if (logger_->should_log(level)) {                                                     \
+                static const utils::log::detail::kv_site site_{event, __FILE__, __LINE__, SPDLOG_FUNCTION}; \
+                utils::log::detail::log_kv(logger_, site_, level, ##__VA_ARGS__);                 \
+            }                                                                                     \
+        }                                                                                         \
+    } while (0)
+
+#define LTRACE_KV(event, ...) LOGGER_KV_CALL(SPDLOG_LEVEL_TRACE, spdlog::level::trace, event, ##__VA_ARGS__)
+#define LDEBUG_KV(event, ...) LOGGER_KV_CALL(SPDLOG_LEVEL_DEBUG, spdlog::level::debug, event, ##__VA_ARGS__)
+#define LINFO_KV(event, ...) LOGGER_KV_CALL(SPDLOG_LEVEL_INFO, spdlog::level::info, event, ##__VA_ARGS__)
+#define LWARN_KV(event, ...) LOGGER_KV_CALL(SPDLOG_LEVEL_WARN, spdlog::level::warn, event, ##__VA_ARGS__)
+#define LERROR_KV(event, ...) LOGGER_KV_CALL(SPDLOG_LEVEL_ERROR, spdlog::level::err, event, ##__VA_ARGS__)
+#define LFATAL_KV(event, ...) LOGGER_KV_CALL(SPDLOG_LEVEL_CRITICAL, spdlog::level::critical, event, ##__VA_ARGS__)
+
+// 内置分类，编译期下限默认与 SPDLOG_ACTIVE_LEVEL 相同，可分别覆盖，例如 -DLOGGER_FLOOR_UDEV=SPDLOG_LEVEL_WARN
+// 运行时级别默认 info: utils::log::set_level("rpc", spdlog::level::debug) 或 utils::log::set_levels("rpc=debug")
+#ifndef LOGGER_FLOOR_RPC
+#define LOGGER_FLOOR_RPC SPDLOG_ACTIVE_LEVEL
+#endif
+#ifndef LOGGER_FLOOR_UDEV
+#define LOGGER_FLOOR_UDEV SPDLOG_ACTIVE_LEVEL
+#endif
+#ifndef LOGGER_FLOOR_THREAD
+#define LOGGER_FLOOR_THREAD SPDLOG_ACTIVE_LEVEL
+#endif
+
+LOGGER_CATEGORY(rpc, LOGGER_FLOOR_RPC)
+LOGGER_CATEGORY(udev, LOGGER_FLOOR_UDEV)
+LOGGER_CATEGORY(thread, LOGGER_FLOOR_THREAD)
 
 /*
  * Pattern说明
@@ -0,0 +1,306 @@
+#pragma once
+
+#include <spdlog/sinks/base_sink.h>
+#include <spdlog/sinks/rotating_file_sink.h>
+#include <spdlog/details/os.h>
+#include <string>
+#include <deque>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <algorithm>
+#include <cstring>
+#include <cstdio>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include "archive.hpp"
+
+namespace utils {
+
+    namespace log {
+
+        // 基于 mmap 的滚动文件 sink，文件命名与 rotating_file_sink 相同: app.log, app.1.log ... app.N.log
+        // 每个文件 (段) 创建时就用 fallocate 分配好 max_file_size 并 MAP_POPULATE 映射，写日志只是一次 memcpy
+        // 后台线程提前准备好下一段；当前段写满时只在锁内切换指针，关闭旧段、改名、删除最旧的文件和准备新段都在后台完成
+        // 段在写满前文件末尾是 0 填充，关闭时截断到实际长度；进程崩溃时已写入的日志仍在页缓存中，不会丢失
+        class mmap_file_sink : public spdlog::sinks::base_sink<std::mutex>
+        {
+            struct segment {
+                int fd = -1;
+                char *data = nullptr;
+                std::size_t size = 0;
+                std::size_t used = 0;
+                std::string path;
+            };
+
+            struct retired {
+                segment seg;
+                std::string successor;          // 接替它的段的临时文件名
+            };
+
+        public:
+            // 给出 archiver 时写满的文件交给它归档，不再按 max_files 依次改名
+            mmap_file_sink(std::string filename, std::size_t max_file_size, std::size_t max_files,
+                           std::shared_ptr<archiver> archiver = nullptr)
+                : _base(std::move(filename)), _max_size(std::max<std::size_t>(max_file_size, 4096)), _max_files(max_files),
+                  _archiver(std::move(archiver)) {
+                recover_spares();
+                _active = open_segment(_base, false);
+                _worker = std::thread(&mmap_file_sink::background, this);
+            }
+
+            ~mmap_file_sink() override {
+                {
+                    std::lock_guard<std::mutex> lock{ _bg_lock };
+                    _run = false;
+                }
+                _bg_cv.notify_one();
+                if (_worker.joinable())
+                    _worker.join();
+                close_segment(_active);
+                if (_spare.fd >= 0) {
+                    std::string path = _spare.path;
+                    close_segment(_spare);
+                    ::unlink(path.c_str());
+                }
+            }
+
+            mmap_file_sink(const mmap_file_sink&) = delete;
+            mmap_file_sink& operator=(const mmap_file_sink&) = delete;
+
+            // 后台还没准备好下一段时，切换时在调用线程同步创建的次数；持续增长说明日志写得比后台准备得快
+            std::size_t sync_rotations() {
+                std::lock_guard<std::mutex> lock{ mutex_ };
+                return _sync_rotations;
+            }
+
+        protected:
+            void sink_it_(const spdlog::details::log_msg &msg) override {
+                spdlog::memory_buf_t formatted;
+                formatter_->format(msg, formatted);
+                const char *p = formatted.data();
+                std::size_t n = formatted.size();
+                // 剩余空间放不下就先切换，一条日志不跨两个文件；只有比整段还大的日志才拆开写
+                if (_active.used > 0 && n > _active.size - _active.used)
+                    rotate();
+                while (n > 0) {
+                    if (_active.used == _active.size)
+                        rotate();
+                    std::size_t chunk = std::min(n, _active.size - _active.used);
+                    std::memcpy(_active.data + _active.used, p, chunk);
+                    _active.used += chunk;
+                    p += chunk;
+                    n -= chunk;
+                }
+            }
+
+            // 数据已在页缓存中，进程退出不会丢；只提示内核尽快回写，不等待
+            void flush_() override {
+                if (_active.data)
+                    ::msync(_active.data, _active.size, MS_ASYNC);
+            }
+
+        private:
+            // 当前段写满: 换上后台准备好的段，旧段交给后台，调用者持有 mutex_
+            void rotate() {
+                segment next;
+                {
+                    std::lock_guard<std::mutex> lock{ _bg_lock };
+                    if (_spare.fd >= 0) {
+                        next = _spare;
+                        _spare = segment();
+                    }
+                }
+                if (next.fd < 0) {
+                    next = open_segment(spare_name(), true);
+                    _sync_rotations++;
+                }
+                {
+                    std::lock_guard<std::mutex> lock{ _bg_lock };
+                    _retired.push_back(retired{ _active, next.path });
+                }
+                _active = next;
+                _bg_cv.notify_one();
+            }
+
+            // 准备中的段用临时文件名，轮到它成为当前段后由后台改名为 app.log
+            std::string spare_name() {
+                return _base + ".next" + std::to_string(_spare_seq.fetch_add(1, std::memory_order_relaxed));
+            }
+
+            // 上次进程异常退出留下的临时段 (app.log.nextN): 没写过的直接删除
+            // 写过的是当时已切换、还没来得及改名的段，截断到实际长度后按切换顺序接到 app.log 之后
+            void recover_spares() {
+                std::size_t slash = _base.rfind('/');
+                std::string dir = slash == std::string::npos ? "./" : _base.substr(0, slash + 1);
+                std::string prefix = (slash == std::string::npos ? _base : _base.substr(slash + 1)) + ".next";
+                std::vector<std::pair<unsigned long, std::string>> found;
+                DIR *d = ::opendir(dir.c_str());
+                if (!d)
+                    return;
+                while (struct dirent *e = ::readdir(d)) {
+                    std::string name = e->d_name;
+                    if (name.size() <= prefix.size() || name.compare(0, prefix.size(), prefix) != 0
+                        || name.find_first_not_of("0123456789", prefix.size()) != std::string::npos)
+                        continue;
+                    found.emplace_back(std::stoul(name.substr(prefix.size())), dir + name);
+                }
+                ::closedir(d);
+                std::sort(found.begin(), found.end());
+                for (auto &spare : found) {
+                    const std::string &path = spare.second;
+                    std::size_t used = written_length(path);
+                    if (used == 0)
+                        ::unlink(path.c_str());
+                    else if (::truncate(path.c_str(), static_cast<off_t>(used)) == 0)
+                        shift_files(path);
+                }
+            }
+
+            // 文件去掉末尾 0 填充后的长度，从后往前读
+            static std::size_t written_length(const std::string &path) {
+                int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+                if (fd < 0)
+                    return 0;
+                struct stat st;
+                std::size_t end = ::fstat(fd, &st) == 0 ? static_cast<std::size_t>(st.st_size) : 0;
+                char buf[64 * 1024];
+                while (end > 0) {
+                    std::size_t n = std::min(end, sizeof(buf));
+                    if (::pread(fd, buf, n, static_cast<off_t>(end - n)) != static_cast<ssize_t>(n)) {
+                        end = 0;
+                        break;
+                    }
+                    while (n > 0 && buf[n - 1] == '\0')
+                        n--, end--;
+                    if (n > 0)
+                        break;
+                }
+                ::close(fd);
+                return end;
+            }
+
+            // 打开 (或创建) 段文件并映射，fresh 为 false 时接着文件中已有的内容写
+            segment open_segment(const std::string &path, bool fresh) {
+                segment seg;
+                seg.path = path;
+                seg.fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC | (fresh ? O_TRUNC : 0), 0644);
+                if (seg.fd < 0)
+                    spdlog::throw_spdlog_ex("open log segment failed: " + path, errno);
+                struct stat st;
+                std::size_t existing = ::fstat(seg.fd, &st) == 0 ? static_cast<std::size_t>(st.st_size) : 0;
+                seg.size = std::max(_max_size, existing);
+                // 预先分配磁盘块，写入时不会因为分配块或磁盘满触发 SIGBUS；不支持时退回 ftruncate
+                if (::posix_fallocate(seg.fd, 0, static_cast<off_t>(seg.size)) != 0 && ::ftruncate(seg.fd, static_cast<off_t>(seg.size)) != 0) {
+                    int err = errno;
+                    ::close(seg.fd);
+                    spdlog::throw_spdlog_ex("allocate log segment failed: " + path, err);
+                }
+                void *data = ::mmap(nullptr, seg.size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, seg.fd, 0);
+                if (data == MAP_FAILED) {
+                    int err = errno;
+                    ::close(seg.fd);
+                    spdlog::throw_spdlog_ex("mmap log segment failed: " + path, err);
+                }
+                seg.data = static_cast<char*>(data);
+                // 续写已有文件: 上次正常关闭时已截断，崩溃时末尾是 0 填充
+                seg.used = existing;
+                while (seg.used > 0 && seg.data[seg.used - 1] == '\0')
+                    seg.used--;
+                return seg;
+            }
+
+            // 解除映射并截断到实际写入的长度
+            static void close_segment(segment &seg) {
+                if (seg.fd < 0)
+                    return;
+                ::munmap(seg.data, seg.size);
+                if (::ftruncate(seg.fd, static_cast<off_t>(seg.used)) != 0) {
+                    // 截断失败只会在文件末尾留下 0 填充，不影响已写入的内容
+                }
+                ::close(seg.fd);
+                seg = segment();
+            }
+
+            // app.log -> app.1.log -> ... -> app.N.log，最旧的被删除 (或交给 archiver)；然后把新的当前段改名为 app.log
+            void shift_files(const std::string &active_path) {
+                using spdlog::sinks::rotating_file_sink_mt;
+                if (_archiver) {
+                    _archiver->retire();
+                } else if (_max_files == 0) {
+                    ::unlink(_base.c_str());
+                } else {
+                    for (std::size_t i = _max_files; i > 0; --i) {
+                        std::string src = rotating_file_sink_mt::calc_filename(_base, i - 1);
+                        std::string dst = rotating_file_sink_mt::calc_filename(_base, i);
+                        if (!spdlog::details::os::path_exists(src))
+                            continue;
+                        std::rename(src.c_str(), dst.c_str());
+                    }
+                }
+                std::rename(active_path.c_str(), _base.c_str());
+            }
+
+            // 按切换顺序处理旧段: 处理到某一段时它已经被改名为 app.log (初始段本来就是)
+            void background() {
+#ifdef SCHED_BATCH
+                // 批处理调度: 被唤醒时不抢占正在写日志的线程，CPU 紧张时后台工作不会变成调用者的延迟
+                sched_param param{};
+                ::pthread_setschedparam(::pthread_self(), SCHED_BATCH, &param);
+#endif
+                std::unique_lock<std::mutex> lock{ _bg_lock };
+                while (_run || !_retired.empty()) {
+                    if (!_retired.empty()) {
+                        retired job = std::move(_retired.front());
+                        _retired.pop_front();
+                        lock.unlock();
+                        close_segment(job.seg);
+                        shift_files(job.successor);
+                        lock.lock();
+                        continue;
+                    }
+                    if (_spare.fd < 0) {
+                        lock.unlock();
+                        segment seg;
+                        try {
+                            seg = open_segment(spare_name(), true);
+                        } catch (const spdlog::spdlog_ex &) {
+                            // 准备失败 (例如磁盘满) 时不重试，切换时在调用线程再试一次并抛出异常
+                        }
+                        lock.lock();
+                        _spare = seg;
+                        if (seg.fd < 0)
+                            _bg_cv.wait(lock);
+                        continue;
+                    }
+                    _bg_cv.wait(lock);
+                }
+            }
+
+            const std::string _base;
+            const std::size_t _max_size;
+            const std::size_t _max_files;
+            std::shared_ptr<archiver> _archiver;
+            segment _active;                    // mutex_ 保护
+            std::size_t _sync_rotations = 0;    // mutex_ 保护
+            std::atomic<std::size_t> _spare_seq{ 0 };
+            std::mutex _bg_lock;
+            std::condition_variable _bg_cv;
+            segment _spare;                     // 准备好的下一段，_bg_lock 保护
+            std::deque<retired> _retired;       // 等待关闭和改名的旧段，_bg_lock 保护
+            bool _run = true;
+            std::thread _worker;
+        };
+
+    }  // log
+
+}  // utils
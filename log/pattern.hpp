@@ -0,0 +1,12 @@
+#pragma once
+
+namespace utils {
+
+    namespace log {
+
+        // logger 的文本输出格式 (spdlog pattern)，log/decoder.cpp 还原二进制日志时默认也用它，两边的输出保持一致
+        inline constexpr char default_pattern[] = "[%H:%M:%S] [%^---%L---%$] [%v]\n[%C-%m-%d] [thread %t] [%s:%!:%#]";
+
+    }  // log
+
+}  // utils
@@ -0,0 +1,135 @@
+#pragma once
+
+#include <spdlog/logger.h>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <thread>
+
+#include "binary_log.hpp"
+
+namespace utils {
+
+    namespace log {
+
+        namespace detail {
+
+            inline std::int64_t steady_ns() {
+                return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now().time_since_epoch()).count();
+            }
+
+            // 限流/采样日志的调用点状态，由 L*_EVERY_N 等宏在调用点定义为函数内 static
+            // 只用 relaxed 原子操作，多线程同时经过同一调用点时不加锁；计数在并发下可能有一两条的偏差
+            // 构造时登记到全局链表 (只增不删)，刷新和退出时由 report_suppressed 汇总还没报告的条数
+            class rate_site
+            {
+            public:
+                rate_site(spdlog::level::level_enum level, const char *file, int line, const char *function)
+                    : level(level), loc{ file, line, function }, summary(level, "{} similar messages suppressed", file, line, function) {
+                    auto &head = list();
+                    _link = head.load(std::memory_order_relaxed);
+                    while (!head.compare_exchange_weak(_link, this, std::memory_order_release, std::memory_order_relaxed))
+                        ;
+                }
+
+                rate_site(const rate_site&) = delete;
+                rate_site& operator=(const rate_site&) = delete;
+
+                // 第 1、n+1、2n+1 ... 次调用通过
+                bool every_n(std::uint64_t n) {
+                    std::uint64_t count = _count.fetch_add(1, std::memory_order_relaxed);
+                    return n <= 1 || count % n == 0 || suppress();
+                }
+
+                // 每 ms 毫秒最多通过一次，第一次调用总是通过
+                bool every_ms(std::int64_t ms) {
+                    std::int64_t now = steady_ns();
+                    std::int64_t next = _next.load(std::memory_order_relaxed);
+                    if (now >= next && _next.compare_exchange_strong(next, now + ms * 1000000, std::memory_order_relaxed))
+                        return true;
+                    return suppress();
+                }
+
+                // 以概率 p 通过，每个线程一个 xorshift 随机数发生器
+                bool sampled(double p) {
+                    thread_local std::uint64_t state = std::hash<std::thread::id>()(std::this_thread::get_id()) | 1;
+                    state ^= state << 13;
+                    state ^= state >> 7;
+                    state ^= state << 17;
+                    return static_cast<double>(state >> 11) * (1.0 / 9007199254740992.0) < p || suppress();
+                }
+
+                // 前 n 次调用通过，之后只计数
+                bool first_n(std::uint64_t n) {
+                    return _count.fetch_add(1, std::memory_order_relaxed) < n || suppress();
+                }
+
+                // 取出上次报告以来被抑制的条数；没有被抑制或距上次报告不足 1 秒时返回 0，每个调用点最多每秒报告一次
+                std::uint64_t take_suppressed() {
+                    if (_suppressed.load(std::memory_order_relaxed) == 0)
+                        return 0;
+                    std::int64_t now = steady_ns();
+                    std::int64_t next = _report.load(std::memory_order_relaxed);
+                    if (now < next || !_report.compare_exchange_strong(next, now + 1000000000, std::memory_order_relaxed))
+                        return 0;
+                    return _suppressed.exchange(0, std::memory_order_relaxed);
+                }
+
+                // 取出全部还没报告的条数，不受每秒一次的限制
+                std::uint64_t take_all() { return _suppressed.exchange(0, std::memory_order_relaxed); }
+
+                // 遍历所有已登记的调用点
+                template<class F>
+                static void for_each(F &&f) {
+                    for (rate_site *site = list().load(std::memory_order_acquire); site; site = site->_link)
+                        f(*site);
+                }
+
+                const spdlog::level::level_enum level;
+                const spdlog::source_loc loc;
+                binary::site summary;                           // 二进制模式下汇总行的调用点
+
+            private:
+                static std::atomic<rate_site*>& list() {
+                    static std::atomic<rate_site*> head{ nullptr };
+                    return head;
+                }
+
+                bool suppress() {
+                    _suppressed.fetch_add(1, std::memory_order_relaxed);
+                    return false;
+                }
+
+                std::atomic<std::uint64_t> _count{ 0 };
+                std::atomic<std::int64_t> _next{ 0 };           // every_ms: 下次允许通过的时间
+                std::atomic<std::int64_t> _report{ 0 };         // 下次允许报告汇总的时间
+                std::atomic<std::uint64_t> _suppressed{ 0 };
+                rate_site *_link = nullptr;                     // 登记链表中的下一个，登记后不再改变
+            };
+
+            // 把各调用点还没报告的抑制条数各写一行汇总，级别和源码位置与原日志相同
+            // 与其他日志走同一条路径: 二进制模式下写入二进制文件，否则交给 logger
+            // FIRST_N 超出 n 之后不再有输出，被抑制的总数只在这里报告
+            inline void report_suppressed(spdlog::logger *logger) {
+                if (!logger)
+                    return;
+                rate_site::for_each([logger](rate_site &site) {
+                    if (!logger->should_log(site.level))
+                        return;
+                    std::uint64_t dropped = site.take_all();
+                    if (dropped == 0)
+                        return;
+                    if (binary::enabled())
+                        binary::write(site.summary, dropped);
+                    else
+                        logger->log(site.loc, site.level, "{} similar messages suppressed", dropped);
+                });
+            }
+
+        }  // detail
+
+    }  // log
+
+}  // utils
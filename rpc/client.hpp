@@ -3,6 +3,18 @@
 #include <exception>
 #include <thread>
 #include <vector>
+#include <string>
+#include <set>
+#include <unordered_map>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
 #include "nn.hpp"
 
 namespace utils {
@@ -10,78 +22,138 @@ namespace utils {
     namespace rpc {
         // /req/[topic]/[uuid]:[data] 提问消息格式
         // /rep/[topic]/[uuid]:[data] 应答消息格式
+        // 每个 client 只有一个常驻的应答订阅和一个接收线程，按 uuid 把应答交给等待它的调用者
+        // 同一方法的并发请求互不干扰；uuid 为 client 的随机前缀加递增序号
         class client            // client
         {
+            // 等待应答的请求，对象在调用者的栈上，由 pending_lock_ 保护
+            struct pending_call {
+                std::vector<std::string> replies;
+                std::condition_variable cv;
+            };
+
         public:
-            client () : pub_sock_(AF_SP, NN_PUB) {
+            client () : pub_sock_(AF_SP, NN_PUB)
+                      , sub_sock_(AF_SP, NN_SUB)
+                      , prefix_(make_prefix())
+                      , running_(true) {
                 pub_sock_.connect(IPC_SUBSCRIBE_SOCKET_PATH);
+                // 接收超时只用于定期检查 running_，不影响请求的超时
+                int timeout = 100;
+                sub_sock_.setsockopt (NN_SOL_SOCKET, NN_RCVTIMEO, &timeout, sizeof (timeout));
+                sub_sock_.connect (IPC_BROADCAST_SOCKET_PATH);
+                receiver_thread_ = std::thread (&client::receiver, this);
+            }
+            virtual ~client () {
+                running_ = false;
+                receiver_thread_.join();
             }
-            virtual ~client () { }
-            // 一问一答，同步请求
+            // 一问一答，同步请求，超时返回空字符串
             std::string request (std::string &&method, std::string &&data, int timeout = 3000) {
-                std::string subject = "/rep/" + method + "/";
-                nn::socket sub_sock (AF_SP, NN_SUB);
-                sub_sock.setsockopt (NN_SUB, NN_SUB_SUBSCRIBE, subject.c_str(), subject.length());
-                sub_sock.connect (IPC_BROADCAST_SOCKET_PATH);
-                sub_sock.setsockopt (NN_SOL_SOCKET, NN_RCVTIMEO, &timeout, sizeof (timeout));
-
+                pending_call call;
+                std::string id = send_request(method, data, call);
+                std::unique_lock<std::mutex> lock {pending_lock_};
+                call.cv.wait_for(lock, std::chrono::milliseconds(timeout), [&call] { return !call.replies.empty(); });
+                pending_.erase(id);
+                return call.replies.empty() ? "" : std::move(call.replies.front());
+            }
+            // 一问多答，收集结果；超过 timeout 毫秒没有新的应答时结束
+            std::vector<std::string> survey (std::string &&method, std::string &&data, int timeout = 500) {
+                pending_call call;
+                std::string id = send_request(method, data, call);
+                std::unique_lock<std::mutex> lock {pending_lock_};
+                std::size_t seen = 0;
+                while (call.cv.wait_for(lock, std::chrono::milliseconds(timeout), [&] { return call.replies.size() > seen; }))
+                    seen = call.replies.size();
+                pending_.erase(id);
+                return std::move(call.replies);
+            }
+            // 异步请求，返回一个future 信息，进程间速度很快，暂时不做
+            // 单发，不等待应答 (服务端的应答没有人认领，由接收线程丢弃)
+            void singleshot (std::string &&method, std::string &&data) {
                 // 发送远程调用
-                subject.replace(0, 5, "/req/");
-                std::string sndbuf = subject + ":" + data;
+                std::string sndbuf = "/req/" + method + "/" + next_id() + ":" + data;
                 std::cout << "发送消息 : " << sndbuf << "\n";
                 pub_sock_.send (sndbuf.c_str(), sndbuf.size() + 1, 0);
+            }
 
-                // 收取回复结果
-                try {
-                    char * buf = nullptr;
-                    int size = sub_sock.recv(&buf, NN_MSG, 0);
-                    std::string ret = strchr(buf, ':') + 1;
-                    nn::freemsg(buf);
-                    return ret;
-                } catch (std::exception &e) {
-                    // 判断是否是超时引起
-                    return "";
-                }
+        private:
+            // 进程号加随机数，同一总线上不同 client 的 uuid 不会重复
+            static std::string make_prefix () {
+                std::random_device rd;
+                char buf[32];
+                snprintf(buf, sizeof(buf), "%x%08x", static_cast<unsigned>(getpid()), static_cast<unsigned>(rd()));
+                return buf;
             }
-            // 一问多答，收集结果
-            std::vector<std::string> survey (std::string &&method, std::string &&data, int timeout = 500) {
-                std::string subject = "/rep/" + method + "/";
-                nn::socket sub_sock (AF_SP, NN_SUB);
-                sub_sock.setsockopt (NN_SUB, NN_SUB_SUBSCRIBE, subject.c_str(), subject.length());
-                sub_sock.connect (IPC_BROADCAST_SOCKET_PATH);
-                sub_sock.setsockopt (NN_SOL_SOCKET, NN_RCVTIMEO, &timeout, sizeof (timeout));
 
-                // 发送远程调用
-                subject.replace(0, 5, "/req/");
-                std::string sndbuf = subject + ":" + data;
-                std::cout << "发送消息 : " << sndbuf << "\n";
-                pub_sock_.send (sndbuf.c_str(), sndbuf.size() + 1, 0);
+            std::string next_id () {
+                return prefix_ + "-" + std::to_string(seq_.fetch_add(1, std::memory_order_relaxed));
+            }
 
-                std::vector<std::string> ret;
-                // 收取回复结果
-                try {
-                    while (1) {
-                        char * buf = nullptr;
-                        int size = sub_sock.recv(&buf, NN_MSG, 0);
-                        ret.push_back(strchr(buf, ':') + 1);
-                        nn::freemsg(buf);
+            // 登记到待应答表后再发送，应答不会在登记之前到达；每个方法第一次请求时订阅它的应答
+            std::string send_request (const std::string &method, const std::string &data, pending_call &call) {
+                std::string id = next_id();
+                {
+                    std::lock_guard<std::mutex> lock {pending_lock_};
+                    if (subscribed_.insert(method).second) {
+                        std::string subject = "/rep/" + method + "/";
+                        sub_sock_.setsockopt (NN_SUB, NN_SUB_SUBSCRIBE, subject.c_str(), subject.length());
                     }
-                } catch (std::exception &e) {
-                    // 判断是否是超时引起
+                    pending_[id] = &call;
                 }
-                return ret;
-            }
-            // 异步请求，返回一个future 信息，进程间速度很快，暂时不做
-            // 单发
-            void singleshot (std::string &&method, std::string &&data) {
                 // 发送远程调用
-                std::string sndbuf = "/req/" + method + ":" + data;
+                std::string sndbuf = "/req/" + method + "/" + id + ":" + data;
                 std::cout << "发送消息 : " << sndbuf << "\n";
-                pub_sock_.send (sndbuf.c_str(), sndbuf.size() + 1, 0);
+                try {
+                    pub_sock_.send (sndbuf.c_str(), sndbuf.size() + 1, 0);
+                } catch (...) {
+                    std::lock_guard<std::mutex> lock {pending_lock_};
+                    pending_.erase(id);
+                    throw;
+                }
+                return id;
+            }
+
+            // 常驻接收线程: 按 /rep/[topic]/[uuid] 中的 uuid 找到等待者，找不到 (已超时或别的 client 的请求) 就丢弃
+            void receiver () {
+                while (running_) {
+                    char * buf = nullptr;
+                    try {
+                        if (sub_sock_.recv(&buf, NN_MSG, 0) < 0)
+                            continue;
+                    } catch (nn::exception &e) {
+                        // 接收超时，检查是否需要退出；nn::term() 之后不再接收
+                        if (e.num() == ETERM)
+                            break;
+                        if (e.num() != ETIMEDOUT)
+                            std::cerr << "[nanomsg]" << e.what() << "\n";
+                        continue;
+                    }
+                    const char *colon = strchr(buf, ':');
+                    if (colon) {
+                        std::string head (buf, colon - buf);
+                        std::string id = head.substr(head.rfind('/') + 1);
+                        std::lock_guard<std::mutex> lock {pending_lock_};
+                        auto it = pending_.find(id);
+                        if (it != pending_.end()) {
+                            it->second->replies.emplace_back(colon + 1);
+                            it->second->cv.notify_one();
+                        }
+                    }
+                    nn::freemsg(buf);
+                }
             }
 
-        private:
             nn::socket pub_sock_;
+            nn::socket sub_sock_;                   // 常驻的应答订阅
+            const std::string prefix_;              // uuid 前缀
+            std::atomic<unsigned long> seq_ {0};
+            std::atomic<bool> running_;
+
+            std::mutex pending_lock_;
+            std::unordered_map<std::string, pending_call*> pending_;   // uuid -> 等待者
+            std::set<std::string> subscribed_;      // 已订阅应答的方法，pending_lock_ 保护
+            std::thread receiver_thread_;
         };
 
     }  // rpc
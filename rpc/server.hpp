@@ -10,6 +10,8 @@
 #include <thread/threadpool.hpp>
 #include "nn.hpp"
 
+#define RPC_SERVER_QUEUE_CAPACITY 1024    // 待处理请求上限，处理不过来时接收线程阻塞，积压留在 nanomsg 的接收缓冲里
+
 namespace utils {
 
     namespace rpc {
@@ -20,7 +22,7 @@ namespace utils {
             server () : running_ (false)
                       , sub_sock_ (AF_SP, NN_SUB)
                       , pub_sock_ (AF_SP, NN_PUB)
-                      , pool (4) {
+                      , pool (pool_options ()) {
                 pub_sock_.connect (IPC_SUBSCRIBE_SOCKET_PATH);
             }
             virtual ~server() { }
@@ -59,8 +61,9 @@ namespace utils {
                     // 拆解
                     std::cout << "收到消息 : size(" << size << ") len("
                               << strlen(buf) << ") data(" << buf << ")\n";
-                    // 执行任务
-                    pool.commit(std::bind(&server::worker, this, buf));
+                    // 执行任务，不关心返回值，用 post 省掉 future
+                    // buf 随后就被释放，必须先拷贝成 std::string
+                    pool.post(&server::worker, this, std::string(buf));
 
                     nn::freemsg(buf);
                 }
@@ -94,6 +97,13 @@ namespace utils {
             }
 
         private:
+            static utils::thread::threadpool_options pool_options () {
+                utils::thread::threadpool_options opts;
+                opts.min_threads = 4;
+                opts.capacity = RPC_SERVER_QUEUE_CAPACITY;
+                opts.overflow = utils::thread::overflow_policy::block;
+                return opts;
+            }
 
             bool running_;
 
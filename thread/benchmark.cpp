@@ -0,0 +1,312 @@
+// 线程池基准测试，输出 JSON 或 CSV，便于在修改 threadpool.hpp 前后对比
+//     g++ -std=c++17 -O2 -I.. benchmark.cpp -o benchmark -pthread
+//     ./benchmark --threads 1,2,4,8 --format csv > result.csv
+// 每个场景先在当前线程串行执行一遍作为基线 (threads = 0)，再按各线程数在线程池上执行
+// 参数:
+//     --threads 1,2,4       线程数列表，默认 1,2,4 以及 CPU 数
+//     --cases empty,fanout  只运行指定场景，默认全部: empty roundtrip fanout producers mixed
+//     --scale 1.0           任务数倍率，机器慢时调小
+//     --format json|csv     默认 json
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <algorithm>
+#include <functional>
+
+#include "threadpool.hpp"
+
+namespace {
+
+    using clock_type = std::chrono::steady_clock;
+
+    std::int64_t now_ns() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(clock_type::now().time_since_epoch()).count();
+    }
+
+    // 忙等 ns 纳秒，模拟计算型任务
+    void spin_for(std::int64_t ns) {
+        std::int64_t end = now_ns() + ns;
+        while (now_ns() < end)
+            ;
+    }
+
+    // 等待计数器到达 n，让出 CPU 以免在单核机器上饿死工作线程
+    void wait_count(const std::atomic<std::int64_t> &done, std::int64_t n) {
+        while (done.load(std::memory_order_acquire) < n)
+            std::this_thread::yield();
+    }
+
+    struct result {
+        std::string name;
+        unsigned threads = 0;           // 0 表示串行基线
+        std::int64_t ops = 0;
+        double seconds = 0;
+        std::int64_t p50 = -1;          // 延迟分位 (纳秒)，不适用的场景为 -1
+        std::int64_t p99 = -1;
+        std::int64_t p999 = -1;
+        double speedup = 0;             // 相对串行基线的吞吐倍数
+
+        double rate() const { return seconds > 0 ? ops / seconds : 0; }
+    };
+
+    void percentiles(result &r, std::vector<std::int64_t> &samples) {
+        if (samples.empty())
+            return;
+        std::sort(samples.begin(), samples.end());
+        auto at = [&](double q) { return samples[std::min(samples.size() - 1, static_cast<std::size_t>(q * samples.size()))]; };
+        r.p50 = at(0.50);
+        r.p99 = at(0.99);
+        r.p999 = at(0.999);
+    }
+
+    // 场景接口: pool 为空时在当前线程串行执行同样的工作量
+    using bench_fn = std::function<result(utils::thread::threadpool *pool, unsigned threads, double scale)>;
+
+    std::int64_t scaled(double scale, std::int64_t n) {
+        return std::max<std::int64_t>(1, static_cast<std::int64_t>(n * scale));
+    }
+
+    // 空任务吞吐: 单个提交者连续 post，衡量队列与唤醒的固定开销
+    result bench_empty(utils::thread::threadpool *pool, unsigned, double scale) {
+        const std::int64_t n = scaled(scale, 1000000);
+        std::atomic<std::int64_t> done{ 0 };
+        auto job = [&done] { done.fetch_add(1, std::memory_order_release); };
+        std::int64_t start = now_ns();
+        for (std::int64_t i = 0; i < n; ++i) {
+            if (pool)
+                pool->post(job);
+            else
+                job();
+        }
+        wait_count(done, n);
+        result r;
+        r.ops = n;
+        r.seconds = (now_ns() - start) / 1e9;
+        return r;
+    }
+
+    // 往返延迟: commit 一个空任务后立即 get，统计提交到拿到结果的时间分布
+    result bench_roundtrip(utils::thread::threadpool *pool, unsigned, double scale) {
+        const std::int64_t n = scaled(scale, 100000);
+        std::vector<std::int64_t> samples;
+        samples.reserve(n);
+        std::int64_t start = now_ns();
+        for (std::int64_t i = 0; i < n; ++i) {
+            std::int64_t t0 = now_ns();
+            if (pool)
+                pool->commit([] { return 0; }).get();
+            else
+                std::packaged_task<int()>([] { return 0; })();
+            samples.push_back(now_ns() - t0);
+        }
+        result r;
+        r.ops = n;
+        r.seconds = (now_ns() - start) / 1e9;
+        percentiles(r, samples);
+        return r;
+    }
+
+    // 扇出/扇入: 每轮提交 64 个约 20 微秒的任务并等待全部完成，统计每轮耗时
+    result bench_fanout(utils::thread::threadpool *pool, unsigned, double scale) {
+        const std::int64_t rounds = scaled(scale, 500);
+        const int width = 64;
+        std::vector<std::future<void>> parts;
+        parts.reserve(width);
+        std::vector<std::int64_t> samples;
+        samples.reserve(rounds);
+        std::int64_t start = now_ns();
+        for (std::int64_t i = 0; i < rounds; ++i) {
+            std::int64_t t0 = now_ns();
+            for (int k = 0; k < width; ++k) {
+                if (pool)
+                    parts.push_back(pool->commit(spin_for, 20000));
+                else
+                    spin_for(20000);
+            }
+            for (auto &part : parts)
+                part.get();
+            parts.clear();
+            samples.push_back(now_ns() - t0);
+        }
+        result r;
+        r.ops = rounds * width;
+        r.seconds = (now_ns() - start) / 1e9;
+        percentiles(r, samples);
+        return r;
+    }
+
+    // 多生产者: 与工作线程同样多的外部线程同时 post 空任务，衡量提交端竞争
+    result bench_producers(utils::thread::threadpool *pool, unsigned threads, double scale) {
+        const unsigned producers = std::max(1u, threads);
+        const std::int64_t per = scaled(scale, 1000000) / producers;
+        std::atomic<std::int64_t> done{ 0 };
+        auto job = [&done] { done.fetch_add(1, std::memory_order_release); };
+        std::int64_t start = now_ns();
+        if (pool) {
+            std::vector<std::thread> senders;
+            for (unsigned p = 0; p < producers; ++p)
+                senders.emplace_back([&] {
+                    for (std::int64_t i = 0; i < per; ++i)
+                        pool->post(job);
+                });
+            for (auto &t : senders)
+                t.join();
+        } else {
+            for (std::int64_t i = 0; i < per * producers; ++i)
+                job();
+        }
+        wait_count(done, per * producers);
+        result r;
+        r.ops = per * producers;
+        r.seconds = (now_ns() - start) / 1e9;
+        return r;
+    }
+
+    // 长短混合: 每 16 个任务中 1 个约 500 微秒，其余约 2 微秒，统计短任务从提交到开始执行的等待时间
+    result bench_mixed(utils::thread::threadpool *pool, unsigned, double scale) {
+        const std::int64_t n = scaled(scale, 20000);
+        std::vector<std::int64_t> samples(n, -1);
+        std::atomic<std::int64_t> done{ 0 };
+        auto job = [&](std::int64_t i, std::int64_t queued) {
+            bool shortjob = i % 16 != 0;
+            if (shortjob)
+                samples[i] = now_ns() - queued;
+            spin_for(shortjob ? 2000 : 500000);
+            done.fetch_add(1, std::memory_order_release);
+        };
+        std::int64_t start = now_ns();
+        for (std::int64_t i = 0; i < n; ++i) {
+            if (pool)
+                pool->post(job, i, now_ns());
+            else
+                job(i, now_ns());
+        }
+        wait_count(done, n);
+        result r;
+        r.ops = n;
+        r.seconds = (now_ns() - start) / 1e9;
+        samples.erase(std::remove(samples.begin(), samples.end(), -1), samples.end());
+        percentiles(r, samples);
+        return r;
+    }
+
+    struct bench_case {
+        const char *name;
+        bench_fn fn;
+    };
+
+    const bench_case all_cases[] = {
+        { "empty", bench_empty },
+        { "roundtrip", bench_roundtrip },
+        { "fanout", bench_fanout },
+        { "producers", bench_producers },
+        { "mixed", bench_mixed },
+    };
+
+    std::vector<std::string> split(const std::string &text) {
+        std::vector<std::string> items;
+        std::size_t pos = 0;
+        while (pos <= text.size()) {
+            std::size_t end = text.find(',', pos);
+            if (end == std::string::npos)
+                end = text.size();
+            if (end > pos)
+                items.push_back(text.substr(pos, end - pos));
+            pos = end + 1;
+        }
+        return items;
+    }
+
+    void print_csv(const std::vector<result> &results) {
+        std::printf("case,threads,ops,seconds,ops_per_sec,speedup,p50_ns,p99_ns,p999_ns\n");
+        for (auto &r : results)
+            std::printf("%s,%u,%lld,%.6f,%.1f,%.3f,%lld,%lld,%lld\n", r.name.c_str(), r.threads, (long long)r.ops,
+                        r.seconds, r.rate(), r.speedup, (long long)r.p50, (long long)r.p99, (long long)r.p999);
+    }
+
+    void print_json(const std::vector<result> &results) {
+        std::printf("{\n  \"hardware_concurrency\": %u,\n  \"results\": [\n", std::thread::hardware_concurrency());
+        for (std::size_t i = 0; i < results.size(); ++i) {
+            auto &r = results[i];
+            std::printf("    {\"case\": \"%s\", \"threads\": %u, \"ops\": %lld, \"seconds\": %.6f, \"ops_per_sec\": %.1f, "
+                        "\"speedup\": %.3f, \"p50_ns\": %lld, \"p99_ns\": %lld, \"p999_ns\": %lld}%s\n",
+                        r.name.c_str(), r.threads, (long long)r.ops, r.seconds, r.rate(), r.speedup,
+                        (long long)r.p50, (long long)r.p99, (long long)r.p999, i + 1 < results.size() ? "," : "");
+        }
+        std::printf("  ]\n}\n");
+    }
+
+}  // namespace
+
+int main(int argc, char *argv[])
+{
+    std::vector<unsigned> thread_counts{ 1, 2, 4 };
+    unsigned cpus = std::max(1u, std::thread::hardware_concurrency());
+    if (std::find(thread_counts.begin(), thread_counts.end(), cpus) == thread_counts.end())
+        thread_counts.push_back(cpus);
+    std::vector<std::string> selected;
+    double scale = 1.0;
+    bool csv = false;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (arg == "--threads" && value) {
+            thread_counts.clear();
+            for (auto &item : split(argv[++i]))
+                thread_counts.push_back(static_cast<unsigned>(std::max(1, std::atoi(item.c_str()))));
+        } else if (arg == "--cases" && value) {
+            selected = split(argv[++i]);
+        } else if (arg == "--scale" && value) {
+            scale = std::atof(argv[++i]);
+        } else if (arg == "--format" && value) {
+            csv = std::strcmp(argv[++i], "csv") == 0;
+        } else {
+            std::fprintf(stderr, "usage: %s [--threads 1,2,4] [--cases empty,roundtrip,fanout,producers,mixed] "
+                                 "[--scale 1.0] [--format json|csv]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    std::vector<result> results;
+    try {
+        for (auto &bench : all_cases) {
+            if (!selected.empty() && std::find(selected.begin(), selected.end(), bench.name) == selected.end())
+                continue;
+            result serial = bench.fn(nullptr, 0, scale);
+            serial.name = bench.name;
+            serial.speedup = 1.0;
+            results.push_back(serial);
+            for (unsigned threads : thread_counts) {
+                // 线程数固定，避免弹性扩缩容干扰结果
+                utils::thread::threadpool_options opts;
+                opts.min_threads = threads;
+                opts.max_threads = threads;
+                utils::thread::threadpool pool{ opts };
+                bench.fn(&pool, threads, scale * 0.1);     // 预热: 建立线程、填充内存池
+                result r = bench.fn(&pool, threads, scale);
+                r.name = bench.name;
+                r.threads = threads;
+                r.speedup = serial.rate() > 0 ? r.rate() / serial.rate() : 0;
+                results.push_back(r);
+            }
+        }
+    }
+    catch (std::exception &e) {
+        std::fprintf(stderr, "benchmark failed: %s\n", e.what());
+        return 1;
+    }
+
+    if (csv)
+        print_csv(results);
+    else
+        print_json(results);
+    return 0;
+}
@@ -0,0 +1,207 @@
+#pragma once
+
+// C++20 协程支持，编译器不支持协程时本文件为空，线程池的其他功能不受影响
+#if __cplusplus > 201703L && defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <utility>
+
+#include "task.hpp"
+#include "future.hpp"
+
+#define THREADPOOL_COROUTINE 1  // 已启用协程，threadpool 提供 schedule()/yield()/spawn()
+
+namespace utils {
+    // 线程相关工具
+    namespace thread {
+        // 协程，与 threadpool 共用工作线程: 协程挂起时不占线程，少量线程即可承载大量进行中的操作
+        namespace coro {
+
+            template<class T = void> class task;
+
+            namespace detail {
+                struct task_promise_base
+                {
+                    std::coroutine_handle<> continuation = std::noop_coroutine();   // 等待本协程的协程
+                    std::exception_ptr error;
+
+                    // 协程创建后先挂起，被 co_await 或 spawn 时才开始执行
+                    std::suspend_always initial_suspend() noexcept { return {}; }
+
+                    // 结束时直接切换到等待者 (对称转移)，等待者在本协程结束的线程上继续执行，不经过队列
+                    struct final_awaiter {
+                        bool await_ready() noexcept { return false; }
+                        template<class P>
+                        std::coroutine_handle<> await_suspend(std::coroutine_handle<P> h) noexcept {
+                            return h.promise().continuation;
+                        }
+                        void await_resume() noexcept { }
+                    };
+                    final_awaiter final_suspend() noexcept { return {}; }
+
+                    void unhandled_exception() noexcept { error = std::current_exception(); }
+                };
+
+                template<class T>
+                struct task_promise : task_promise_base
+                {
+                    std::optional<T> value;
+
+                    template<class V>
+                    void return_value(V &&v) { value.emplace(std::forward<V>(v)); }
+
+                    T result() {
+                        if (error)
+                            std::rethrow_exception(error);
+                        return std::move(*value);
+                    }
+                };
+
+                template<>
+                struct task_promise<void> : task_promise_base
+                {
+                    void return_void() noexcept { }
+
+                    void result() {
+                        if (error)
+                            std::rethrow_exception(error);
+                    }
+                };
+
+                // spawn/sync_wait 使用的驱动协程: 结束后自行销毁
+                struct detached
+                {
+                    struct promise_type {
+                        detached get_return_object() noexcept {
+                            return detached{ std::coroutine_handle<promise_type>::from_promise(*this) };
+                        }
+                        std::suspend_always initial_suspend() noexcept { return {}; }
+                        std::suspend_never final_suspend() noexcept { return {}; }
+                        void return_void() noexcept { }
+                        void unhandled_exception() noexcept { std::terminate(); }
+                    };
+
+                    std::coroutine_handle<promise_type> handle;
+                };
+
+                // 运行 t，把结果或异常写入 result
+                template<class T>
+                detached drive(task<T> t, utils::thread::promise<T> result) {
+                    try {
+                        if constexpr (std::is_void<T>::value) {
+                            co_await std::move(t);
+                            result.set_value();
+                        } else {
+                            result.set_value(co_await std::move(t));
+                        }
+                    } catch (...) {
+                        result.set_exception(std::current_exception());
+                    }
+                }
+            }  // detail
+
+            // 惰性协程任务: 创建时不执行，co_await 时才开始，结束后在它结束的线程上恢复等待者
+            // 只可移动，只能 co_await 一次: T v = co_await make_task();
+            template<class T>
+            class task
+            {
+            public:
+                struct promise_type : detail::task_promise<T> {
+                    task get_return_object() noexcept {
+                        return task(std::coroutine_handle<promise_type>::from_promise(*this));
+                    }
+                };
+
+                task() noexcept = default;
+                task(task &&other) noexcept : _handle(std::exchange(other._handle, nullptr)) { }
+                task& operator=(task &&other) noexcept {
+                    if (this != &other) {
+                        if (_handle)
+                            _handle.destroy();
+                        _handle = std::exchange(other._handle, nullptr);
+                    }
+                    return *this;
+                }
+                ~task() {
+                    if (_handle)
+                        _handle.destroy();
+                }
+
+                bool valid() const noexcept { return _handle != nullptr; }
+
+                auto operator co_await() && noexcept {
+                    struct awaiter {
+                        std::coroutine_handle<promise_type> handle;
+
+                        bool await_ready() noexcept { return handle.done(); }
+                        std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept {
+                            handle.promise().continuation = awaiting;
+                            return handle;
+                        }
+                        T await_resume() { return handle.promise().result(); }
+                    };
+                    return awaiter{ _handle };
+                }
+
+            private:
+                explicit task(std::coroutine_handle<promise_type> handle) noexcept : _handle(handle) { }
+
+                std::coroutine_handle<promise_type> _handle;
+            };
+
+            // co_await 后协程在 exec 上继续执行，threadpool::schedule()/yield() 返回此对象
+            struct schedule_awaiter
+            {
+                executor exec;
+
+                bool await_ready() noexcept { return false; }
+                void await_suspend(std::coroutine_handle<> h) {
+                    exec(utils::thread::task([h] { h.resume(); }));
+                }
+                void await_resume() noexcept { }
+            };
+
+            // 在执行器上启动协程，不等待；返回的 future 可以忽略，也可以 then/get
+            template<class T>
+            utils::thread::future<T> spawn(executor exec, task<T> t) {
+                utils::thread::promise<T> result{ exec };
+                utils::thread::future<T> pending = result.get_future();
+                auto driver = detail::drive(std::move(t), std::move(result));
+                exec(utils::thread::task([h = driver.handle] { h.resume(); }));
+                return pending;
+            }
+
+            // 在当前线程启动协程并阻塞等待结果，用于 main 或测试，不要在工作线程里调用
+            template<class T>
+            T sync_wait(task<T> t) {
+                utils::thread::promise<T> result;
+                utils::thread::future<T> pending = result.get_future();
+                detail::drive(std::move(t), std::move(result)).handle.resume();
+                return pending.get();
+            }
+        }  // coro
+
+        // co_await 一个 utils::thread::future: 就绪后协程经 future 的执行器恢复，等待期间不占线程
+        // int v = co_await pool.async(load, key);
+        template<class T>
+        auto operator co_await(future<T> &&f) {
+            struct awaiter {
+                future<T> f;
+
+                bool await_ready() const { return f.is_ready(); }
+                void await_suspend(std::coroutine_handle<> h) {
+                    auto state = detail::future_access::state(f);   // 持有一份，回调可能立即在别的线程恢复协程并销毁 f
+                    executor exec = state->exec;
+                    state->on_ready(task([h, exec] { exec(task([h] { h.resume(); })); }));
+                }
+                T await_resume() { return f.get(); }
+            };
+            return awaiter{ std::move(f) };
+        }
+
+    }  // thread
+}  // utils
+
+#endif
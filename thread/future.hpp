@@ -0,0 +1,450 @@
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <optional>
+#include <tuple>
+#include <vector>
+#include <chrono>
+#include <future>
+#include <exception>
+#include <functional>
+#include <type_traits>
+#include <utility>
+
+#include "task.hpp"
+
+namespace utils {
+    // 线程相关工具
+    namespace thread {
+
+        // 任务执行器: future 就绪后通过它把续延 (then) 提交到线程池
+        // 只保存上下文指针和提交函数，本文件不依赖 threadpool.hpp；submit 为空时在完成结果的线程上直接执行续延
+        struct executor {
+            void *context = nullptr;
+            void (*submit)(void *context, task &&fn) = nullptr;
+
+            explicit operator bool() const noexcept { return submit != nullptr; }
+
+            void operator()(task &&fn) const {
+                if (submit)
+                    submit(context, std::move(fn));
+                else
+                    fn();
+            }
+        };
+
+        template<class T> class future;
+        template<class T> class promise;
+
+        namespace detail {
+            struct unit {};     // void 结果的占位值
+
+            template<class T>
+            using value_t = typename std::conditional<std::is_void<T>::value, unit, T>::type;
+
+            // future 与 promise 的共享状态
+            // 结果写入后依次调用登记的回调；回调在写入结果的线程上执行，必须很短 (通常只是把续延提交到线程池)
+            template<class T>
+            class future_state
+            {
+            public:
+                explicit future_state(executor exec) : exec(exec) { }
+
+                const executor exec;    // 续延在这里执行
+
+                bool ready() const { return _ready.load(std::memory_order_acquire); }
+
+                template<class... V>
+                void set_value(V&&... v) {
+                    complete([&] { _value.emplace(std::forward<V>(v)...); });
+                }
+
+                void set_exception(std::exception_ptr error) {
+                    complete([&] { _error = std::move(error); });
+                }
+
+                // 就绪后调用 cb，已经就绪时在当前线程立即调用
+                void on_ready(task &&cb) {
+                    {
+                        std::lock_guard<std::mutex> lock{ _lock };
+                        if (!_ready.load(std::memory_order_relaxed)) {
+                            _callbacks.push_back(std::move(cb));
+                            return;
+                        }
+                    }
+                    cb();
+                }
+
+                void wait() {
+                    if (ready())
+                        return;
+                    std::unique_lock<std::mutex> lock{ _lock };
+                    _cv.wait(lock, [this] { return _ready.load(std::memory_order_relaxed); });
+                }
+
+                template<class Rep, class Period>
+                bool wait_for(const std::chrono::duration<Rep, Period> &timeout) {
+                    if (ready())
+                        return true;
+                    std::unique_lock<std::mutex> lock{ _lock };
+                    return _cv.wait_for(lock, timeout, [this] { return _ready.load(std::memory_order_relaxed); });
+                }
+
+                // 等待并取走结果，有异常时重新抛出
+                value_t<T> take() {
+                    wait();
+                    if (_error)
+                        std::rethrow_exception(_error);
+                    return std::move(*_value);
+                }
+
+            private:
+                template<class Set>
+                void complete(Set &&set) {
+                    std::vector<task, pool_allocator<task>> callbacks;
+                    {
+                        std::lock_guard<std::mutex> lock{ _lock };
+                        if (_ready.load(std::memory_order_relaxed))
+                            throw std::future_error(std::future_errc::promise_already_satisfied);
+                        set();
+                        _ready.store(true, std::memory_order_release);
+                        callbacks.swap(_callbacks);
+                    }
+                    _cv.notify_all();
+                    for (auto &cb : callbacks)
+                        cb();
+                }
+
+                std::mutex _lock;
+                std::condition_variable _cv;
+                std::atomic<bool> _ready{ false };
+                std::optional<value_t<T>> _value;
+                std::exception_ptr _error;
+                std::vector<task, pool_allocator<task>> _callbacks;
+            };
+
+            template<class T>
+            std::shared_ptr<future_state<T>> make_state(executor exec) {
+                return std::allocate_shared<future_state<T>>(pool_allocator<future_state<T>>(), exec);
+            }
+
+            // when_all / when_any / then 需要直接访问 future 的共享状态
+            struct future_access {
+                template<class T>
+                static std::shared_ptr<future_state<T>>& state(future<T> &f) { return f._state; }
+
+                template<class T>
+                static future<T> make(std::shared_ptr<future_state<T>> state) { return future<T>(std::move(state)); }
+            };
+
+            template<class T>
+            struct type_tag { using type = T; };
+
+            // then(fn) 的结果类型: fn 可以接收 future<T> (自己处理异常) 或直接接收结果值
+            template<class F, class T>
+            auto then_result() {
+                if constexpr (std::is_invocable<F&, future<T>>::value)
+                    return type_tag<std::invoke_result_t<F&, future<T>>>{};
+                else if constexpr (std::is_void<T>::value)
+                    return type_tag<std::invoke_result_t<F&>>{};
+                else
+                    return type_tag<std::invoke_result_t<F&, T>>{};
+            }
+
+            template<class F, class T>
+            using then_result_t = typename decltype(then_result<F, T>())::type;
+
+            // then 登记的回调: 第一次调用 (在完成结果的线程上) 把自己提交给执行器，第二次调用才执行 fn
+            template<class T, class R, class F>
+            struct continuation
+            {
+                std::shared_ptr<future_state<T>> source;
+                std::shared_ptr<future_state<R>> target;
+                F fn;
+                bool scheduled = false;
+
+                void operator()() {
+                    if (!scheduled && source->exec) {
+                        scheduled = true;
+                        executor exec = source->exec;
+                        exec(task(std::move(*this)));
+                        return;
+                    }
+                    try {
+                        invoke();
+                    } catch (...) {
+                        target->set_exception(std::current_exception());
+                    }
+                }
+
+            private:
+                void invoke() {
+                    future<T> arg = future_access::make(std::move(source));
+                    if constexpr (std::is_invocable<F&, future<T>>::value)
+                        finish(std::move(arg));
+                    else if constexpr (std::is_void<T>::value) {
+                        arg.get();  // 前一步的异常直接传给下一步，不调用 fn
+                        finish();
+                    } else
+                        finish(arg.get());
+                }
+
+                template<class... A>
+                void finish(A&&... a) {
+                    if constexpr (std::is_void<R>::value) {
+                        std::invoke(fn, std::forward<A>(a)...);
+                        target->set_value();
+                    } else {
+                        target->set_value(std::invoke(fn, std::forward<A>(a)...));
+                    }
+                }
+            };
+        }  // detail
+
+        // 可挂续延的 future，由 promise::get_future() 或 threadpool::async() 得到
+        // 与 std::future 一样只可移动，get() 只能调用一次；then() 消耗当前 future，返回下一步的 future
+        template<class T>
+        class future
+        {
+        public:
+            future() noexcept = default;
+            future(future &&) noexcept = default;
+            future& operator=(future &&) noexcept = default;
+
+            bool valid() const noexcept { return _state != nullptr; }
+            bool is_ready() const { return _state && _state->ready(); }
+
+            void wait() const { checked()->wait(); }
+
+            template<class Rep, class Period>
+            std::future_status wait_for(const std::chrono::duration<Rep, Period> &timeout) const {
+                return checked()->wait_for(timeout) ? std::future_status::ready : std::future_status::timeout;
+            }
+
+            // 阻塞等待结果；在线程池任务里调用会占住一个工作线程，能用 then 时尽量用 then
+            T get() {
+                std::shared_ptr<detail::future_state<T>> state = checked();
+                _state.reset();
+                if constexpr (std::is_void<T>::value)
+                    state->take();
+                else
+                    return state->take();
+            }
+
+            // 结果就绪后把 fn 提交给产生该 future 的执行器 (线程池)，不阻塞任何线程
+            // fn 接收 future<T> 时总会被调用，由它自己 get() 处理异常；
+            // fn 接收结果值 (T 为 void 时无参数) 时，前一步的异常直接传给返回的 future，fn 不被调用
+            // pool.async(decode, buf).then(handle).then(reply);
+            template<class F>
+            auto then(F &&fn) -> future<detail::then_result_t<typename std::decay<F>::type, T>> {
+                using Fn = typename std::decay<F>::type;
+                using R = detail::then_result_t<Fn, T>;
+                std::shared_ptr<detail::future_state<T>> state = checked();
+                _state.reset();
+                auto next = detail::make_state<R>(state->exec);
+                detail::future_state<T> &source = *state;
+                source.on_ready(task(detail::continuation<T, R, Fn>{ std::move(state), next, std::forward<F>(fn) }));
+                return future<R>(std::move(next));
+            }
+
+        private:
+            friend struct detail::future_access;
+            template<class> friend class future;
+            friend class promise<T>;
+
+            explicit future(std::shared_ptr<detail::future_state<T>> state) : _state(std::move(state)) { }
+
+            const std::shared_ptr<detail::future_state<T>>& checked() const {
+                if (!_state)
+                    throw std::future_error(std::future_errc::no_state);
+                return _state;
+            }
+
+            std::shared_ptr<detail::future_state<T>> _state;
+        };
+
+        // 与 future 配对的 promise；析构时尚未写入结果则让 future 得到 broken_promise
+        template<class T>
+        class promise
+        {
+        public:
+            promise() : promise(executor{}) { }
+            explicit promise(executor exec) : _state(detail::make_state<T>(exec)) { }
+            promise(promise &&other) noexcept
+                : _state(std::move(other._state)), _retrieved(other._retrieved) { }
+            promise& operator=(promise &&other) noexcept {
+                if (this != &other) {
+                    abandon();
+                    _state = std::move(other._state);
+                    _retrieved = other._retrieved;
+                }
+                return *this;
+            }
+            ~promise() { abandon(); }
+
+            future<T> get_future() {
+                if (!_state)
+                    throw std::future_error(std::future_errc::no_state);
+                if (_retrieved)
+                    throw std::future_error(std::future_errc::future_already_retrieved);
+                _retrieved = true;
+                return future<T>(_state);
+            }
+
+            template<class... V>
+            void set_value(V&&... v) { checked().set_value(std::forward<V>(v)...); }
+
+            void set_exception(std::exception_ptr error) { checked().set_exception(std::move(error)); }
+
+        private:
+            detail::future_state<T>& checked() {
+                if (!_state)
+                    throw std::future_error(std::future_errc::no_state);
+                return *_state;
+            }
+
+            void abandon() {
+                if (_state && !_state->ready())
+                    _state->set_exception(std::make_exception_ptr(std::future_error(std::future_errc::broken_promise)));
+            }
+
+            std::shared_ptr<detail::future_state<T>> _state;
+            bool _retrieved = false;
+        };
+
+        // when_any 的结果: 第一个就绪的 future 的下标及全部 future
+        template<class Sequence>
+        struct when_any_result {
+            std::size_t index;
+            Sequence futures;
+        };
+
+        namespace detail {
+            // 取第一个有效 future 的执行器，组合结果的续延也在同一个线程池执行
+            template<class T>
+            void pick_executor(executor &exec, future<T> &f) {
+                if (!exec && f.valid())
+                    exec = future_access::state(f)->exec;
+            }
+
+            // 依次对每个 future 调用 fn(下标, future)
+            template<class T, class Fn>
+            void for_each_future(std::vector<future<T>> &futures, Fn &&fn) {
+                for (std::size_t i = 0; i < futures.size(); ++i)
+                    fn(i, futures[i]);
+            }
+
+            template<class... T, class Fn>
+            void for_each_future(std::tuple<future<T>...> &futures, Fn &&fn) {
+                std::size_t i = 0;
+                std::apply([&](future<T>&... f) { (fn(i++, f), ...); }, futures);
+            }
+
+            template<class T>
+            std::size_t future_count(const std::vector<future<T>> &futures) { return futures.size(); }
+
+            template<class... T>
+            constexpr std::size_t future_count(const std::tuple<future<T>...> &) { return sizeof...(T); }
+
+            // when_all 的收集器: 计数多留一个给登记过程，防止登记到一半时全部就绪把 futures 移走
+            template<class Sequence>
+            struct all_collector
+            {
+                Sequence futures;
+                std::atomic<std::size_t> remaining;
+                std::shared_ptr<future_state<Sequence>> target;
+
+                void arrive() {
+                    if (remaining.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                        target->set_value(std::move(futures));
+                }
+            };
+
+            template<class Sequence>
+            future<Sequence> when_all(Sequence futures) {
+                executor exec;
+                for_each_future(futures, [&](std::size_t, auto &f) { pick_executor(exec, f); });
+                auto c = std::make_shared<all_collector<Sequence>>();
+                c->remaining = future_count(futures) + 1;
+                c->target = make_state<Sequence>(exec);
+                c->futures = std::move(futures);
+                future<Sequence> result = future_access::make(c->target);
+                for_each_future(c->futures, [&](std::size_t, auto &f) {
+                                                if (f.valid())
+                                                    future_access::state(f)->on_ready(task([c] { c->arrive(); }));
+                                                else
+                                                    c->arrive();
+                                            });
+                c->arrive();
+                return result;
+            }
+
+            // when_any 的收集器: 第一个就绪的 future 和登记过程都结束后才写入结果
+            template<class Sequence>
+            struct any_collector
+            {
+                Sequence futures;
+                std::atomic<std::size_t> index{ static_cast<std::size_t>(-1) };
+                std::atomic<int> latch{ 2 };
+                std::shared_ptr<future_state<when_any_result<Sequence>>> target;
+
+                void fire(std::size_t i) {
+                    std::size_t none = static_cast<std::size_t>(-1);
+                    if (index.compare_exchange_strong(none, i))
+                        release();
+                }
+
+                void release() {
+                    if (latch.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                        target->set_value(when_any_result<Sequence>{ index.load(), std::move(futures) });
+                }
+            };
+
+            template<class Sequence>
+            future<when_any_result<Sequence>> when_any(Sequence futures) {
+                executor exec;
+                for_each_future(futures, [&](std::size_t, auto &f) { pick_executor(exec, f); });
+                auto c = std::make_shared<any_collector<Sequence>>();
+                if (future_count(futures) == 0)
+                    c->latch = 1;   // 没有 future 时立即就绪，index 为 size_t(-1)
+                c->target = make_state<when_any_result<Sequence>>(exec);
+                c->futures = std::move(futures);
+                future<when_any_result<Sequence>> result = future_access::make(c->target);
+                for_each_future(c->futures, [&](std::size_t i, auto &f) {
+                                                if (f.valid())
+                                                    future_access::state(f)->on_ready(task([c, i] { c->fire(i); }));
+                                                else
+                                                    c->fire(i);
+                                            });
+                c->release();
+                return result;
+            }
+        }  // detail
+
+        // 全部就绪后得到所有 future (均已就绪，各自 get() 取结果或异常)
+        template<class... T>
+        future<std::tuple<future<T>...>> when_all(future<T>... futures) {
+            return detail::when_all(std::make_tuple(std::move(futures)...));
+        }
+
+        template<class T>
+        future<std::vector<future<T>>> when_all(std::vector<future<T>> futures) {
+            return detail::when_all(std::move(futures));
+        }
+
+        // 任一就绪后得到它的下标和所有 future；其余 future 仍可继续等待
+        template<class... T>
+        future<when_any_result<std::tuple<future<T>...>>> when_any(future<T>... futures) {
+            return detail::when_any(std::make_tuple(std::move(futures)...));
+        }
+
+        template<class T>
+        future<when_any_result<std::vector<future<T>>>> when_any(std::vector<future<T>> futures) {
+            return detail::when_any(std::move(futures));
+        }
+
+    }  // thread
+}  // utils
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <atomic>
+#include <chrono>
+
+namespace utils {
+    // 线程相关工具
+    namespace thread {
+
+        namespace detail {
+            // 单调时钟纳秒数，用于排队/执行耗时统计
+            inline std::int64_t now_ns() {
+                return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now().time_since_epoch()).count();
+            }
+
+            // 只有一个线程写的计数器: load + store 代替原子加，其他线程用 relaxed load 读到近似值
+            inline void bump(std::atomic<std::uint64_t> &counter, std::uint64_t n = 1) {
+                counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+            }
+        }  // detail
+
+        // 直方图快照，可合并，可查询分位数
+        struct histogram_snapshot
+        {
+            std::uint64_t count = 0;            // 样本数
+            std::uint64_t sum = 0;              // 样本总和 (纳秒)
+            std::uint64_t max = 0;              // 最大样本 (纳秒)
+            std::vector<std::uint64_t> buckets; // 各桶计数
+
+            double mean() const { return count ? static_cast<double>(sum) / count : 0.0; }
+
+            // 分位数，p 取 [0, 1]，返回所在桶的上界，相对误差不超过 1/8
+            std::uint64_t percentile(double p) const;
+
+            void merge(const histogram_snapshot &other) {
+                if (buckets.size() < other.buckets.size())
+                    buckets.resize(other.buckets.size(), 0);
+                for (std::size_t i = 0; i < other.buckets.size(); ++i)
+                    buckets[i] += other.buckets[i];
+                count += other.count;
+                sum += other.sum;
+                if (other.max > max)
+                    max = other.max;
+            }
+        };
+
+        // 对数分桶的延迟直方图 (纳秒)
+        // 小于 8 的值每个值一个桶，之后每个 2 的幂区间再等分 8 个桶；记录只有几次 relaxed 原子加
+        class histogram
+        {
+        public:
+            static constexpr int sub_bits = 3;
+            static constexpr int sub_count = 1 << sub_bits;
+            static constexpr int bucket_count = (64 - sub_bits + 1) * sub_count;
+
+            static int bucket_of(std::uint64_t v) {
+                if (v < sub_count)
+                    return static_cast<int>(v);
+                int msb = 63 - __builtin_clzll(v);
+                int exp = msb - sub_bits + 1;
+                return exp * sub_count + static_cast<int>((v >> (msb - sub_bits)) & (sub_count - 1));
+            }
+
+            // 桶 i 覆盖 [lower_bound(i), lower_bound(i + 1))
+            static std::uint64_t lower_bound(int i) {
+                if (i < sub_count)
+                    return i;
+                int exp = i / sub_count;
+                return static_cast<std::uint64_t>(sub_count + i % sub_count) << (exp - 1);
+            }
+
+            void record(std::int64_t ns) {
+                std::uint64_t v = ns > 0 ? static_cast<std::uint64_t>(ns) : 0;
+                _buckets[bucket_of(v)].fetch_add(1, std::memory_order_relaxed);
+                _count.fetch_add(1, std::memory_order_relaxed);
+                _sum.fetch_add(v, std::memory_order_relaxed);
+                std::uint64_t max = _max.load(std::memory_order_relaxed);
+                while (v > max && !_max.compare_exchange_weak(max, v, std::memory_order_relaxed))
+                    ;
+            }
+
+            histogram_snapshot snapshot() const {
+                histogram_snapshot s;
+                s.buckets.resize(bucket_count);
+                for (int i = 0; i < bucket_count; ++i)
+                    s.buckets[i] = _buckets[i].load(std::memory_order_relaxed);
+                s.count = _count.load(std::memory_order_relaxed);
+                s.sum = _sum.load(std::memory_order_relaxed);
+                s.max = _max.load(std::memory_order_relaxed);
+                return s;
+            }
+
+        private:
+            std::atomic<std::uint64_t> _buckets[bucket_count] = {};
+            std::atomic<std::uint64_t> _count{ 0 };
+            std::atomic<std::uint64_t> _sum{ 0 };
+            std::atomic<std::uint64_t> _max{ 0 };
+        };
+
+        inline std::uint64_t histogram_snapshot::percentile(double p) const {
+            std::uint64_t total = 0;
+            for (auto n : buckets)
+                total += n;
+            if (total == 0)
+                return 0;
+            std::uint64_t rank = static_cast<std::uint64_t>(p * total + 0.5);
+            if (rank < 1)
+                rank = 1;
+            std::uint64_t seen = 0;
+            for (std::size_t i = 0; i < buckets.size(); ++i) {
+                seen += buckets[i];
+                if (seen >= rank) {
+                    std::uint64_t upper = histogram::lower_bound(static_cast<int>(i) + 1) - 1;
+                    return upper < max ? upper : max;
+                }
+            }
+            return max;
+        }
+
+    }  // thread
+}  // utils
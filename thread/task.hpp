@@ -0,0 +1,495 @@
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <vector>
+#include <tuple>
+#include <future>
+#include <utility>
+#include <exception>
+#include <functional>
+#include <type_traits>
+
+namespace utils {
+    // 线程相关工具
+    namespace thread {
+
+#define THREADPOOL_TASK_INLINE_SIZE 64      // task 内联存储字节数，放得下的可调用对象不分配堆内存
+#define THREADPOOL_BLOCK_CACHE_LIMIT 256    // 每个线程每个尺寸级别最多缓存的内存块数量
+
+        namespace detail {
+
+            // 按尺寸分级的线程本地内存块缓存 (64/128/256/512 字节)
+            // 块可以在任意线程释放，释放时进入释放线程的缓存；生产者分配、工作线程释放的场景下，
+            // 缓存超过上限时把一半成批转交全局仓库，缓存为空时再成批取回，每次加锁摊到几十次分配上
+            class block_cache
+            {
+                struct node { node *next; };
+                struct batch { node *head; std::size_t count; };
+                static constexpr int classes = 4;
+                static constexpr std::size_t min_block = 64;
+
+                // 全局仓库，只在成批转移时加锁
+                struct depot {
+                    std::mutex lock;
+                    std::vector<batch> batches[classes];
+
+                    ~depot() {
+                        for (auto &list : batches)
+                            for (auto &b : list)
+                                release(b.head);
+                    }
+                };
+
+                node *_free[classes] = {};
+                std::size_t _count[classes] = {};
+
+                static bool& alive() {
+                    static thread_local bool flag = false; // 平凡类型，线程退出后仍可访问
+                    return flag;
+                }
+
+                static depot& shared() {
+                    static depot d;
+                    return d;
+                }
+
+                static void release(node *n) {
+                    while (n) {
+                        node *next = n->next;
+                        ::operator delete(n);
+                        n = next;
+                    }
+                }
+
+                block_cache() { shared(); alive() = true; }
+
+            public:
+                ~block_cache() {
+                    alive() = false;
+                    depot &d = shared();
+                    std::lock_guard<std::mutex> lock{ d.lock };
+                    for (int c = 0; c < classes; ++c)
+                        if (_free[c])
+                            d.batches[c].push_back(batch{ _free[c], _count[c] });
+                }
+
+                block_cache(const block_cache&) = delete;
+                block_cache& operator=(const block_cache&) = delete;
+
+                static int size_class(std::size_t size) {
+                    for (int c = 0; c < classes; ++c)
+                        if (size <= (min_block << c))
+                            return c;
+                    return -1;
+                }
+
+                // 线程退出阶段缓存已析构，返回 nullptr
+                static block_cache* local() {
+                    static thread_local block_cache cache;
+                    return alive() ? &cache : nullptr;
+                }
+
+                static void* allocate(std::size_t size) {
+                    int c = size_class(size);
+                    block_cache *cache = c < 0 ? nullptr : local();
+                    if (!cache)
+                        return ::operator new(c < 0 ? size : (min_block << c));
+                    if (!cache->_free[c]) {
+                        depot &d = shared();
+                        std::lock_guard<std::mutex> lock{ d.lock };
+                        if (!d.batches[c].empty()) {
+                            cache->_free[c] = d.batches[c].back().head;
+                            cache->_count[c] = d.batches[c].back().count;
+                            d.batches[c].pop_back();
+                        }
+                    }
+                    if (node *n = cache->_free[c]) {
+                        cache->_free[c] = n->next;
+                        cache->_count[c]--;
+                        return n;
+                    }
+                    return ::operator new(min_block << c);
+                }
+
+                static void deallocate(void *p, std::size_t size) {
+                    int c = size_class(size);
+                    block_cache *cache = c < 0 ? nullptr : local();
+                    if (!cache) {
+                        ::operator delete(p);
+                        return;
+                    }
+                    node *n = static_cast<node*>(p);
+                    n->next = cache->_free[c];
+                    cache->_free[c] = n;
+                    if (++cache->_count[c] < THREADPOOL_BLOCK_CACHE_LIMIT)
+                        return;
+                    // 拆下一半交给全局仓库
+                    std::size_t half = cache->_count[c] / 2;
+                    node *head = cache->_free[c], *tail = head;
+                    for (std::size_t i = 1; i < half; ++i)
+                        tail = tail->next;
+                    cache->_free[c] = tail->next;
+                    cache->_count[c] -= half;
+                    tail->next = nullptr;
+                    depot &d = shared();
+                    std::lock_guard<std::mutex> lock{ d.lock };
+                    d.batches[c].push_back(batch{ head, half });
+                }
+            };
+
+            // 可增长的环形缓冲区，稳定状态下入队出队不分配内存 (std::deque 每几个元素就要分配一个块)
+            template<class T>
+            class ring
+            {
+                T *_buf = nullptr;
+                std::size_t _cap = 0;   // 2 的幂
+                std::size_t _head = 0;
+                std::size_t _size = 0;
+
+                T* slot(std::size_t i) { return _buf + ((_head + i) & (_cap - 1)); }
+
+                void grow() {
+                    std::size_t cap = _cap ? _cap * 2 : 16;
+                    T *buf = static_cast<T*>(::operator new(cap * sizeof(T)));
+                    for (std::size_t i = 0; i < _size; ++i) {
+                        T *src = slot(i);
+                        new (buf + i) T(std::move(*src));
+                        src->~T();
+                    }
+                    ::operator delete(_buf);
+                    _buf = buf;
+                    _cap = cap;
+                    _head = 0;
+                }
+
+            public:
+                ring() = default;
+                ~ring() {
+                    clear();
+                    ::operator delete(_buf);
+                }
+                ring(const ring&) = delete;
+                ring& operator=(const ring&) = delete;
+
+                bool empty() const { return _size == 0; }
+                std::size_t size() const { return _size; }
+
+                T& operator[](std::size_t i) { return *slot(i); }
+                T& front() { return *slot(0); }
+                T& back() { return *slot(_size - 1); }
+
+                template<class... Args>
+                void emplace_back(Args&&... args) {
+                    if (_size == _cap)
+                        grow();
+                    new (slot(_size)) T(std::forward<Args>(args)...);
+                    ++_size;
+                }
+                void push_back(T &&value) { emplace_back(std::move(value)); }
+
+                void pop_front() {
+                    slot(0)->~T();
+                    _head = (_head + 1) & (_cap - 1);
+                    --_size;
+                }
+                void pop_back() {
+                    slot(_size - 1)->~T();
+                    --_size;
+                }
+                void clear() {
+                    while (_size)
+                        pop_back();
+                }
+
+                // 移除所有满足 pred 的元素，其余元素保持原有顺序；被移除的元素移交给 sink，可以在锁外析构
+                template<class Pred, class Sink>
+                std::size_t remove_if(Pred &&pred, Sink &&sink) {
+                    std::size_t kept = 0;
+                    for (std::size_t i = 0; i < _size; ++i) {
+                        T *cur = slot(i);
+                        if (pred(*cur))
+                            sink(std::move(*cur));
+                        else if (kept++ != i)
+                            *slot(kept - 1) = std::move(*cur);
+                    }
+                    std::size_t removed = _size - kept;
+                    while (_size > kept)
+                        pop_back();
+                    return removed;
+                }
+            };
+
+        }  // detail
+
+        // 从线程本地内存块缓存分配的分配器，用于 std::promise 的共享状态等小对象
+        template<class T>
+        struct pool_allocator
+        {
+            using value_type = T;
+
+            pool_allocator() noexcept = default;
+            template<class U>
+            pool_allocator(const pool_allocator<U>&) noexcept { }
+
+            T* allocate(std::size_t n) {
+                if (alignof(T) > __STDCPP_DEFAULT_NEW_ALIGNMENT__)
+                    return std::allocator<T>().allocate(n);
+                return static_cast<T*>(detail::block_cache::allocate(n * sizeof(T)));
+            }
+            void deallocate(T *p, std::size_t n) noexcept {
+                if (alignof(T) > __STDCPP_DEFAULT_NEW_ALIGNMENT__)
+                    return std::allocator<T>().deallocate(p, n);
+                detail::block_cache::deallocate(p, n * sizeof(T));
+            }
+
+            template<class U>
+            bool operator==(const pool_allocator<U>&) const noexcept { return true; }
+            template<class U>
+            bool operator!=(const pool_allocator<U>&) const noexcept { return false; }
+        };
+
+        // 只可移动的 void() 任务，替代 std::function<void()>
+        // 不要求可调用对象可拷贝，小于 THREADPOOL_TASK_INLINE_SIZE 的直接放在对象内部
+        class task
+        {
+            struct vtable {
+                void (*invoke)(void *self);
+                void (*move)(void *dst, void *src);     // 移动构造到 dst 并析构 src
+                void (*destroy)(void *self);
+            };
+
+            template<class F>
+            static constexpr bool is_inline = sizeof(F) <= THREADPOOL_TASK_INLINE_SIZE
+                && alignof(F) <= alignof(std::max_align_t)
+                && std::is_nothrow_move_constructible<F>::value;
+
+            template<class F>
+            static const vtable* inline_vtable() {
+                static const vtable vt = {
+                    [](void *self) { (*static_cast<F*>(self))(); },
+                    [](void *dst, void *src) {
+                        new (dst) F(std::move(*static_cast<F*>(src)));
+                        static_cast<F*>(src)->~F();
+                    },
+                    [](void *self) { static_cast<F*>(self)->~F(); },
+                };
+                return &vt;
+            }
+
+            template<class F>
+            static const vtable* heap_vtable() {
+                static const vtable vt = {
+                    [](void *self) { (**static_cast<F**>(self))(); },
+                    [](void *dst, void *src) { *static_cast<F**>(dst) = *static_cast<F**>(src); },
+                    [](void *self) { delete *static_cast<F**>(self); },
+                };
+                return &vt;
+            }
+
+            alignas(std::max_align_t) unsigned char _buf[THREADPOOL_TASK_INLINE_SIZE];
+            const vtable *_vt = nullptr;
+
+        public:
+            task() noexcept = default;
+
+            template<class F, class Fn = typename std::decay<F>::type,
+                     class = typename std::enable_if<!std::is_same<Fn, task>::value>::type>
+            task(F &&f) {
+                if constexpr (is_inline<Fn>) {
+                    new (_buf) Fn(std::forward<F>(f));
+                    _vt = inline_vtable<Fn>();
+                } else {
+                    *reinterpret_cast<Fn**>(_buf) = new Fn(std::forward<F>(f));
+                    _vt = heap_vtable<Fn>();
+                }
+            }
+
+            task(task &&other) noexcept : _vt(other._vt) {
+                if (_vt) {
+                    _vt->move(_buf, other._buf);
+                    other._vt = nullptr;
+                }
+            }
+
+            task& operator=(task &&other) noexcept {
+                if (this != &other) {
+                    reset();
+                    if (other._vt) {
+                        other._vt->move(_buf, other._buf);
+                        _vt = other._vt;
+                        other._vt = nullptr;
+                    }
+                }
+                return *this;
+            }
+
+            task(const task&) = delete;
+            task& operator=(const task&) = delete;
+
+            ~task() { reset(); }
+
+            void reset() noexcept {
+                if (_vt) {
+                    _vt->destroy(_buf);
+                    _vt = nullptr;
+                }
+            }
+
+            explicit operator bool() const noexcept { return _vt != nullptr; }
+
+            void operator()() { _vt->invoke(_buf); }
+        };
+
+        namespace detail {
+
+            // commit 使用: 调用函数并把结果或异常写入 promise
+            // 参数按值保存，以左值传入，与 std::bind 的行为一致
+            // Promise 也可以是 utils::thread::promise<R> (async 使用)，只要求 set_value/set_exception
+            template<class R, class F, class Tuple, class Promise = std::promise<R>>
+            struct packaged
+            {
+                Promise promise;
+                F fn;
+                Tuple args;
+
+                void operator()() {
+                    try {
+                        set(std::is_void<R>());
+                    } catch (...) {
+                        promise.set_exception(std::current_exception());
+                    }
+                }
+
+            private:
+                void set(std::true_type) {
+                    std::apply(fn, args);
+                    promise.set_value();
+                }
+                void set(std::false_type) {
+                    promise.set_value(std::apply(fn, args));
+                }
+            };
+
+            // post 使用: 没有人等待结果，异常直接丢弃 (与丢弃 future 的效果一致)
+            template<class F, class Tuple>
+            struct invoker
+            {
+                F fn;
+                Tuple args;
+
+                void operator()() {
+                    try {
+                        std::apply(fn, args);
+                    } catch (...) {
+                    }
+                }
+            };
+
+            // commit_bulk 的共享状态: 整批任务共用一个计数器和一个 promise，最后完成的任务负责收尾
+            template<class F>
+            struct bulk_state
+            {
+                F fn;
+                std::promise<void> promise;
+                std::atomic<std::size_t> remaining;
+                std::atomic<bool> failed{ false };
+                std::exception_ptr error;   // 只记录第一个异常
+
+                template<class Fn>
+                bulk_state(Fn &&f, std::size_t count) : fn(std::forward<Fn>(f)), remaining(count) { }
+
+                void fail(std::exception_ptr e) {
+                    if (!failed.exchange(true))
+                        error = e;
+                }
+
+                void finish() {
+                    if (--remaining > 0)
+                        return;
+                    if (error)
+                        promise.set_exception(error);
+                    else
+                        promise.set_value();
+                    delete this;
+                }
+            };
+
+            // commit_bulk 的单个元素，未执行就被销毁时按 broken_promise 计入整批结果
+            template<class State, class Iter>
+            struct bulk_item
+            {
+                State *state;
+                Iter it;
+
+                bulk_item(State *s, Iter i) : state(s), it(std::move(i)) { }
+                bulk_item(bulk_item &&other) noexcept : state(other.state), it(std::move(other.it)) { other.state = nullptr; }
+                ~bulk_item() {
+                    if (state) {
+                        state->fail(std::make_exception_ptr(std::future_error(std::future_errc::broken_promise)));
+                        state->finish();
+                    }
+                }
+
+                void operator()() {
+                    State *s = state;
+                    state = nullptr;
+                    try {
+                        s->fn(*it);
+                    } catch (...) {
+                        s->fail(std::current_exception());
+                    }
+                    s->finish();
+                }
+            };
+
+            // parallel_for / parallel_reduce 的分块状态
+            // 参与者 (调用线程和若干辅助任务) 通过 next 动态领取分块，done 计满后唤醒调用线程
+            // 调用线程等到所有分块完成才返回，晚到的辅助任务领不到分块，不会再访问 body
+            struct chunk_state
+            {
+                std::size_t chunks;
+                void *body;
+                void (*call)(void *body, std::size_t chunk);
+                std::atomic<std::size_t> next{ 0 };
+                std::atomic<std::size_t> done{ 0 };
+                std::atomic<bool> failed{ false };
+                std::exception_ptr error;
+                std::mutex lock;
+                std::condition_variable cv;
+
+                template<class Body>
+                chunk_state(std::size_t n, Body &b)
+                    : chunks(n), body(&b), call([](void *p, std::size_t c) { (*static_cast<Body*>(p))(c); }) { }
+
+                void run() {
+                    for (std::size_t c; (c = next++) < chunks; ) {
+                        if (!failed) {
+                            try {
+                                call(body, c);
+                            } catch (...) {
+                                if (!failed.exchange(true))
+                                    error = std::current_exception();
+                            }
+                        }
+                        if (++done == chunks) {
+                            std::lock_guard<std::mutex> guard{ lock };
+                            cv.notify_all();
+                        }
+                    }
+                }
+
+                void wait() {
+                    std::unique_lock<std::mutex> guard{ lock };
+                    cv.wait(guard, [this]{ return done == chunks; });
+                }
+            };
+
+        }  // detail
+
+    }  // thread
+}  // utils
@@ -0,0 +1,217 @@
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <tuple>
+#include <chrono>
+#include <exception>
+#include <stdexcept>
+#include <utility>
+#include <algorithm>
+
+#include "threadpool.hpp"
+
+namespace utils {
+    // 线程相关工具
+    namespace thread {
+
+        // cancellation_token::throw_if_cancelled() 抛出，task_group 内的任务抛出它不算失败
+        class task_cancelled : public std::runtime_error
+        {
+        public:
+            task_cancelled() : std::runtime_error("task cancelled.") { }
+        };
+
+        namespace detail {
+            // task_group 与其任务共享的状态，任务持有它，task_group 先析构也没关系
+            struct group_state
+            {
+                std::atomic<bool> cancelled{ false };
+                std::atomic<int> outstanding{ 0 };      // 已提交未结束 (含排队中) 的任务数
+                std::mutex lock;
+                std::condition_variable cv;
+                std::exception_ptr error;               // 第一个失败任务的异常
+
+                void finish() {
+                    if (outstanding.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                        std::lock_guard<std::mutex> guard{ lock };
+                        cv.notify_all();
+                    }
+                }
+
+                // 记录第一个异常并取消其余任务
+                void fail(std::exception_ptr e) {
+                    {
+                        std::lock_guard<std::mutex> guard{ lock };
+                        if (!error)
+                            error = std::move(e);
+                    }
+                    cancelled.store(true, std::memory_order_release);
+                }
+            };
+
+            // task_group 提交的任务: 开始前检查是否已取消；没有执行就被移除或丢弃时在析构里结束计数
+            template<class F, class Tuple>
+            struct group_item
+            {
+                std::shared_ptr<group_state> state;
+                F fn;
+                Tuple args;
+
+                template<class Fn>
+                group_item(std::shared_ptr<group_state> state, Fn &&fn, Tuple &&args)
+                    : state(std::move(state)), fn(std::forward<Fn>(fn)), args(std::move(args)) { }
+                group_item(group_item &&) = default;
+                ~group_item() {
+                    if (state)
+                        state->finish();
+                }
+
+                void operator()() {
+                    std::shared_ptr<group_state> s = std::move(state);
+                    if (!s->cancelled.load(std::memory_order_acquire)) {
+                        try {
+                            std::apply(fn, args);
+                        } catch (const task_cancelled &) {
+                        } catch (...) {
+                            s->fail(std::current_exception());
+                        }
+                    }
+                    s->finish();
+                }
+            };
+        }  // detail
+
+        // 取消令牌，任务在长循环中轮询，发现已取消时尽早返回
+        // 默认构造的令牌永远不会被取消
+        class cancellation_token
+        {
+        public:
+            cancellation_token() noexcept = default;
+
+            bool cancelled() const noexcept {
+                return _state && _state->cancelled.load(std::memory_order_acquire);
+            }
+
+            void throw_if_cancelled() const {
+                if (cancelled())
+                    throw task_cancelled();
+            }
+
+        private:
+            friend class task_group;
+            explicit cancellation_token(std::shared_ptr<const detail::group_state> state) : _state(std::move(state)) { }
+
+            std::shared_ptr<const detail::group_state> _state;
+        };
+
+        // 一组逻辑上属于同一个作业的任务，可以整体等待和取消
+        // cancel() 把还在排队的任务直接从线程池队列移除，已经开始的任务通过 token() 轮询后自行结束
+        // 任一任务抛出异常时整组被取消，wait() 重新抛出第一个异常
+        //     utils::thread::task_group group{ pool };
+        //     for (auto &part : parts)
+        //         group.spawn([&, tok = group.token()] { while (!tok.cancelled() && step(part)) ; });
+        //     if (!group.wait_for(timeout)) group.cancel();
+        class task_group
+        {
+        public:
+            explicit task_group(threadpool &pool)
+                : _pool(pool), _state(std::make_shared<detail::group_state>()) { }
+
+            // 析构前等待已开始的任务结束，任务可以放心引用调用者栈上的数据
+            ~task_group() {
+                try {
+                    wait();
+                } catch (...) {
+                }
+            }
+
+            task_group(const task_group&) = delete;
+            task_group& operator=(const task_group&) = delete;
+
+            // 提交一个任务到组内，已取消的组不再接受任务，直接忽略
+            template<class F, class... Args>
+            void spawn(F&& f, Args&&... args) {
+                spawn(priority::normal, std::forward<F>(f), std::forward<Args>(args)...);
+            }
+
+            template<class F, class... Args>
+            void spawn(priority level, F&& f, Args&&... args) {
+                if (cancelled())
+                    return;
+                using item_t = detail::group_item<typename std::decay<F>::type, std::tuple<typename std::decay<Args>::type...>>;
+                _state->outstanding.fetch_add(1, std::memory_order_relaxed);
+                // 提交失败 (线程池已停止或队列满被拒绝) 时 item 析构，计数随之归还
+                _pool.offer(level, item_t(_state, std::forward<F>(f), std::make_tuple(std::forward<Args>(args)...)),
+                            nullptr, _state.get());
+            }
+
+            // 取消: 之后提交的任务被忽略，排队中的任务被移除，正在执行的任务通过令牌感知
+            // 返回从队列中移除的任务数
+            std::size_t cancel() {
+                _state->cancelled.store(true, std::memory_order_release);
+                return _pool.purge(_state.get());
+            }
+
+            bool cancelled() const { return _state->cancelled.load(std::memory_order_acquire); }
+
+            cancellation_token token() const { return cancellation_token(_state); }
+
+            // 等待组内所有任务结束 (执行完、被取消或被移除)，有任务失败时抛出第一个异常
+            // 在工作线程内调用时先帮忙执行队列里的任务，不会占着线程干等；其他线程直接等最后一个任务结束的通知
+            void wait() {
+                if (_pool.in_worker()) {
+                    while (!done()) {
+                        if (_pool.help_one())
+                            continue;
+                        // 队列暂时没有任务可帮，短暂等待后再看，期间可能有新的任务入队
+                        std::unique_lock<std::mutex> lock{ _state->lock };
+                        _state->cv.wait_for(lock, std::chrono::milliseconds(1), [this] { return done(); });
+                    }
+                } else {
+                    std::unique_lock<std::mutex> lock{ _state->lock };
+                    _state->cv.wait(lock, [this] { return done(); });
+                }
+                std::exception_ptr error;
+                {
+                    std::lock_guard<std::mutex> lock{ _state->lock };
+                    error = std::exchange(_state->error, nullptr);
+                }
+                if (error)
+                    std::rethrow_exception(error);
+            }
+
+            // 最多等待 timeout，全部结束返回 true；不会抛出任务的异常，之后调用 wait() 取得
+            template<class Rep, class Period>
+            bool wait_for(const std::chrono::duration<Rep, Period> &timeout) {
+                auto deadline = std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(timeout);
+                if (!_pool.in_worker()) {
+                    std::unique_lock<std::mutex> lock{ _state->lock };
+                    return _state->cv.wait_until(lock, deadline, [this] { return done(); });
+                }
+                while (!done()) {
+                    if (_pool.help_one())
+                        continue;
+                    std::unique_lock<std::mutex> lock{ _state->lock };
+                    auto slice = std::min(deadline, std::chrono::steady_clock::now() + std::chrono::steady_clock::duration(std::chrono::milliseconds(1)));
+                    _state->cv.wait_until(lock, slice, [this] { return done(); });
+                    if (std::chrono::steady_clock::now() >= deadline)
+                        return done();
+                }
+                return true;
+            }
+
+            // 未结束的任务数
+            int size() const { return _state->outstanding.load(std::memory_order_acquire); }
+
+        private:
+            bool done() const { return _state->outstanding.load(std::memory_order_acquire) == 0; }
+
+            threadpool &_pool;
+            std::shared_ptr<detail::group_state> _state;
+        };
+
+    }  // thread
+}  // utils
@@ -1,116 +1,1265 @@
 #pragma once
 
 #include <vector>
-#include <queue>
 #include <memory>
 #include <thread>
 #include <mutex>
 #include <condition_variable>
 #include <future>
-#include <functional>
+#include <tuple>
+#include <iterator>
+#include <optional>
+#include <algorithm>
 #include <exception>
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+
+#include "task.hpp"
+#include "metrics.hpp"
+#include "future.hpp"
+#include "coroutine.hpp"
+#include "timer.hpp"
+#include "topology.hpp"
 
 namespace utils {
     // 线程相关工具
     namespace thread {
 
-#define THREADPOOL_MAX_NUM 16   //线程池最大容量，应尽量设小一点
-#define THREADPOOL_MIN_NUM 4    //线程池最小容量，应尽量设小一点
+#define THREADPOOL_MAX_NUM 16   //线程池最大容量默认值，运行期可通过 threadpool_options 调整
+#define THREADPOOL_MIN_NUM 4    //线程池最小容量默认值，运行期可通过 threadpool_options 调整
+#define THREADPOOL_SLOT_LIMIT 1024  // 线程数量硬上限，max_threads 不能超过
 
 #define THREADPOOL_AUTO_GROW    // 定义线程池大小自改变
+#define THREADPOOL_STARVATION_LIMIT 16  // 每个工作线程每取这么多次任务，就倒过来先从低优先级队列取一次，防止饿死
+
+// 自旋等待时每次循环执行的让步指令，降低功耗并让出超线程的执行资源
+#if defined(__x86_64__) || defined(__i386__)
+#define THREADPOOL_CPU_RELAX() __builtin_ia32_pause()
+#elif defined(__aarch64__) || defined(__arm__)
+#define THREADPOOL_CPU_RELAX() asm volatile("yield" ::: "memory")
+#else
+#define THREADPOOL_CPU_RELAX() std::this_thread::yield()
+#endif
+
+        // 调度方式
+        enum class schedule_mode {
+            fifo,                   // 所有任务进入同一个共享队列，严格先进先出
+            work_stealing,          // 每个工作线程一个双端队列，空闲线程互相窃取
+        };
+
+        // 任务优先级，每个级别一个独立队列
+        enum class priority : unsigned char {
+            high,                   // 延迟敏感，例如 RPC 请求处理
+            normal,                 // 默认
+            low,                    // 批量、后台任务
+        };
+
+        // 工作线程的 CPU 放置方式
+        enum class placement_policy {
+            none,                   // 不绑定，由内核调度
+            pinned,                 // 第 i 个槽位的线程绑定到 cpu_sets[i % n]，cpu_sets 为空时每个线程绑定一个可用 CPU
+            spread,                 // 线程均匀分布到各 NUMA 节点，绑定到所在节点的全部 CPU
+            per_node,               // 每个 NUMA 节点一个子线程池: 同 spread，另外每个节点至少保留一个线程，先在本节点内窃取
+        };
+
+        // 工作线程没有任务时的等待方式
+        enum class wait_strategy {
+            block,                  // 直接睡眠在条件变量上，提交任务需要一次 futex 唤醒和上下文切换
+            spin_then_park,         // 先用 pause 指令自旋 spin_time，再 yield 同样长时间，仍没有任务才睡眠
+        };
+
+        // 排队任务达到 capacity 时的处理方式
+        enum class overflow_policy {
+            block,                  // 提交者阻塞到有空位；在工作线程内提交时改为 caller_runs，避免互相等待死锁
+            reject,                 // 抛出 queue_full
+            caller_runs,            // 在提交者线程上直接执行，提交者自然被拖慢
+            discard_oldest,         // 丢弃最旧的任务 (先从低优先级队列丢)，被丢弃任务的 future 得到 broken_promise
+        };
+
+        // 队列已满且策略为 reject 时 commit/post 抛出
+        class queue_full : public std::runtime_error
+        {
+        public:
+            queue_full() : std::runtime_error("ThreadPool queue is full.") { }
+        };
+
+        // 队列满时各种处理的累计次数，用于发现持续过载
+        struct overflow_stats {
+            std::uint64_t rejected = 0;     // reject 抛出的次数和 try_commit/try_post 失败的次数
+            std::uint64_t blocked = 0;      // 提交者阻塞等待的次数
+            std::uint64_t caller_runs = 0;  // 在提交者线程上执行的任务数
+            std::uint64_t discarded = 0;    // 被丢弃的任务数
+        };
+
+        // 把任务投递到指定 NUMA 节点的队列: .commit(numa_node{ 1 }, fn)，id 为内核中的节点编号
+        struct numa_node {
+            int id;
+        };
+
+        // 线程池运行参数，除 mode、placement、cpu_sets 外都可以在运行期通过 configure() 修改
+        struct threadpool_options {
+            unsigned min_threads = THREADPOOL_MIN_NUM;     // 常驻线程数，空闲也不退出
+            unsigned max_threads = std::max<unsigned>(THREADPOOL_MAX_NUM, std::thread::hardware_concurrency());
+            std::chrono::milliseconds grow_delay{ 1 };     // 扩容滞后: 积压任务多于空闲线程的状态持续这么久才新建线程
+            std::chrono::milliseconds idle_timeout{ 60000 }; // 多于 min_threads 的线程空闲这么久后退出，0 表示不退出
+            schedule_mode mode = schedule_mode::work_stealing;
+            placement_policy placement = placement_policy::none;
+            std::vector<cpu_set> cpu_sets;                 // pinned 方式使用的 CPU 集合
+            std::size_t capacity = 0;                      // 排队任务数上限，0 表示不限
+            overflow_policy overflow = overflow_policy::block;
+            bool metrics = true;                           // 记录排队/执行/空闲耗时，关闭后每个任务少读两次时钟，计数器不受影响
+            wait_strategy wait = wait_strategy::block;
+            std::chrono::microseconds spin_time{ 50 };     // spin_then_park 的 pause 阶段和 yield 阶段各自的时长
+            unsigned max_spinners = 1;                     // 同时自旋的线程数上限，其余空闲线程直接睡眠，空闲的线程池不会占满所有 CPU
+        };
+
+        // 单个工作线程 (槽位) 的统计，槽位被复用时累计
+        struct worker_stats {
+            int index = 0;                  // 槽位下标
+            bool active = false;            // 当前是否有线程在该槽位上运行
+            int node = -1;                  // 所在 NUMA 节点下标
+            std::uint64_t executed = 0;     // 执行的任务数
+            std::uint64_t steals = 0;       // 从其他线程私有队列或其他节点队列取到的任务数
+            std::uint64_t idle_ns = 0;      // 睡眠等待任务的时间
+            histogram_snapshot exec;        // 任务执行耗时 (纳秒)，sum 即忙碌时间
+        };
+
+        // 线程池统计快照，各项分别读取，彼此之间不保证严格一致
+        struct threadpool_stats {
+            int threads = 0;                // 存活线程数
+            int idle = 0;                   // 空闲线程数
+            int pending = 0;                // 排队任务数
+            int peak_pending = 0;           // 排队任务数的最高水位
+            std::uint64_t submitted = 0;    // 进入队列的任务总数 (不含 caller_runs 在提交者线程上执行的)
+            std::uint64_t executed = 0;     // 工作线程执行的任务总数
+            std::uint64_t steals = 0;
+            histogram_snapshot wait[3];     // 按优先级 (high, normal, low) 的排队耗时
+            histogram_snapshot exec;        // 所有线程合并的执行耗时
+            overflow_stats overflow;
+            std::vector<worker_stats> workers;
+
+            // 忙碌时间占 忙碌+睡眠 时间的比例；只算工作线程，不含管理线程和定时线程
+            double utilization() const {
+                std::uint64_t busy = 0, idle_ns = 0;
+                for (auto &w : workers) {
+                    busy += w.exec.sum;
+                    idle_ns += w.idle_ns;
+                }
+                return busy + idle_ns ? static_cast<double>(busy) / (busy + idle_ns) : 0.0;
+            }
+        };
+
 // 线程池,可以提交变参函数或拉姆达表达式的匿名函数执行,可以获取执行返回值
 // 不直接支持类成员函数, 支持类静态成员函数或全局函数,Opteron()函数等
 
         class threadpool
         {
-            using task_t = std::function<void()>; // 定义类型
-            std::vector<std::thread> _pool;       // 线程池
-            std::queue<task_t> _tasks;            // 任务队列
-            std::mutex _lock;                          // 同步
+            using task_t = utils::thread::task;   // 定义类型，只可移动，小对象内联存储
+
+            static constexpr int priority_count = 3;
+
+            // 队列中的任务，带入队时间用于统计排队耗时
+            struct job {
+                task_t fn;
+                std::int64_t queued;
+                const void *tag = nullptr;  // 所属 task_group，取消时按它从队列中移除
+            };
+
+            friend class task_group;
+
+            // 工作线程及其私有的任务队列，私有队列只存放 normal 级别任务
+            // 本线程从尾部压入/弹出 (LIFO，刚产生的任务数据还在缓存里)，其他线程从头部窃取 (FIFO)
+            // 线程退出后槽位保留，扩容时复用
+            struct worker_slot {
+                std::mutex lock;
+                detail::ring<job> tasks;
+                unsigned picks = 0;     // 本线程取任务次数，只有本线程访问，用于防饿死
+                std::thread thread;
+                std::atomic<bool> active{ false };
+                std::atomic<int> node{ -1 };  // 所在 NUMA 节点下标，不绑定时为 -1
+                cpu_set cpus;           // 线程启动时绑定的 CPU，只在线程创建前写入
+                // 统计，只有本槽位的线程写
+                std::atomic<std::uint64_t> executed{ 0 };
+                std::atomic<std::uint64_t> steals{ 0 };
+                std::atomic<std::uint64_t> idle_ns{ 0 };
+                histogram exec;
+            };
+
+            // 共享注入队列，每个优先级一个，各自加锁
+            struct lane {
+                std::mutex lock;
+                detail::ring<job> tasks;
+                std::atomic<int> size{ 0 };     // 不加锁判断队列是否为空
+            };
+
+            // NUMA 节点的任务队列，投递到该节点的任务优先由本节点线程执行，
+            // 本节点线程都忙时其他节点的空闲线程在没有别的任务可做时也会来取，不会饿死
+            struct node_queue {
+                lane tasks;
+                std::atomic<int> live{ 0 };     // 本节点存活线程数量
+            };
+
+            // 当前线程所属的线程池及其槽位下标，非工作线程为 nullptr
+            struct worker_context {
+                threadpool *pool = nullptr;
+                int index = -1;
+            };
+
+            std::vector<std::unique_ptr<worker_slot>> _pool;  // 线程池，只在持有 _grow_lock 时访问
+            std::unique_ptr<std::atomic<worker_slot*>[]> _slots; // 已发布的槽位，窃取时无锁遍历
+            lane _lanes[priority_count];          // 任务队列，按优先级划分 (工作窃取模式下为外部线程的注入队列)
+            histogram _wait[priority_count];      // 各优先级排队耗时
+            numa_topology _topology;              // 构造时读取，placement 为 none 时为空
+            std::unique_ptr<node_queue[]> _nodes; // 与 _topology.nodes 一一对应
+            std::mutex _lock;                          // 同步，工作线程睡眠用
+            std::mutex _grow_lock;                     // 保护 _pool 扩容
+            std::mutex _manage_lock;                   // 管理线程睡眠用
             std::condition_variable _task_cv;          // 条件阻塞
+            unsigned _config_gen = 0;                  // configure() 的次数，_lock 保护，用于唤醒不限时睡眠的线程
+            std::condition_variable _manage_cv;        // 唤醒管理线程
+            std::thread _manager;                      // 管理线程，负责扩容，创建线程不在提交路径上
+            std::once_flag _timer_once;
+            std::shared_ptr<timer_wheel> _timer;       // 定时任务，第一次使用时才创建定时线程
             std::atomic<bool> _run{ true };            // 线程池是否执行
+            std::atomic<bool> _grow_request{ false };  // 已请求管理线程检查扩容
             std::atomic<int>  _idlThrNum{ 0 };         // 空闲线程数量
+            std::atomic<int>  _live{ 0 };              // 存活线程数量
+            std::atomic<int>  _qnum{ 0 };              // 已发布的槽位数量
+            std::atomic<int>  _pending{ 0 };           // 所有队列中等待执行的任务数量
+            std::atomic<int>  _sleepers{ 0 };          // 阻塞在 _task_cv 上的线程数量
+            std::atomic<int>  _min{ 1 };               // 线程数量下限
+            std::atomic<int>  _max{ 1 };               // 线程数量上限
+            std::atomic<std::int64_t> _grow_delay{ 0 };    // 扩容滞后，纳秒
+            std::atomic<std::int64_t> _idle_timeout{ 0 };  // 空闲退出时间，纳秒
+            std::atomic<std::size_t> _capacity{ 0 };       // 排队任务数上限，0 表示不限
+            std::atomic<overflow_policy> _overflow{ overflow_policy::block };
+            std::mutex _space_lock;                    // 等待空位的提交者睡眠用
+            std::condition_variable _space_cv;
+            std::atomic<int> _space_waiters{ 0 };      // 等待空位的提交者数量
+            std::atomic<std::uint64_t> _rejected{ 0 };
+            std::atomic<std::uint64_t> _blocked{ 0 };
+            std::atomic<std::uint64_t> _caller_runs{ 0 };
+            std::atomic<std::uint64_t> _discarded{ 0 };
+            std::atomic<std::uint64_t> _submitted{ 0 };
+            std::atomic<int>  _peak_pending{ 0 };      // 排队任务数最高水位
+            std::atomic<bool> _metrics{ true };        // 是否记录耗时
+            std::atomic<wait_strategy> _wait_strategy{ wait_strategy::block };
+            std::atomic<std::int64_t> _spin_ns{ 0 };   // 每个自旋阶段的时长，纳秒
+            std::atomic<int>  _max_spinners{ 1 };
+            std::atomic<int>  _spinners{ 0 };          // 正在自旋等待任务的线程数量
+            const schedule_mode _mode;
+            const placement_policy _placement;
+            const std::vector<cpu_set> _cpu_sets;
+
+            static threadpool_options default_options(unsigned short size, schedule_mode mode) {
+                threadpool_options opts;
+                opts.min_threads = size;
+#ifdef THREADPOOL_AUTO_GROW
+                opts.max_threads = std::max<unsigned>(size, opts.max_threads);
+#else
+                opts.max_threads = size;
+#endif // !THREADPOOL_AUTO_GROW
+                opts.mode = mode;
+                return opts;
+            }
 
         public:
-            inline threadpool(unsigned short size = 4) { addThread(size); }
+            inline threadpool(unsigned short size = 4, schedule_mode mode = schedule_mode::work_stealing)
+                : threadpool(default_options(size, mode)) { }
+            inline explicit threadpool(const threadpool_options &opts)
+                : _slots(new std::atomic<worker_slot*>[THREADPOOL_SLOT_LIMIT]()), _mode(opts.mode),
+                  _placement(opts.placement), _cpu_sets(pinned_sets(opts)) {
+                if (_placement != placement_policy::none) {
+                    _topology = numa_topology::detect();
+                    _nodes.reset(new node_queue[_topology.nodes.size()]);
+                }
+                configure(opts);
+                addThread(_min);
+                _manager = std::thread(&threadpool::manager, this);
+            }
             inline ~threadpool() {
-                _run = false;
+                if (_timer)
+                    _timer->stop();     // 先停止定时器，未触发的定时任务丢弃
+                {
+                    std::lock_guard<std::mutex> lock{ _manage_lock };
+                    _run = false;
+                }
+                _manage_cv.notify_all();
+                _manager.join();
+                { std::lock_guard<std::mutex> lock{ _space_lock }; }
+                _space_cv.notify_all();     // 阻塞等待空位的提交者
+
+                { std::lock_guard<std::mutex> lock{ _lock }; }
                 _task_cv.notify_all(); // 唤醒所有线程执行
-                for (auto& thread : _pool) {
+                for (auto& slot : _pool) {
                     //thread.detach(); // 让线程“自生自灭”
-                    if(thread.joinable())
-                        thread.join(); // 等待任务结束， 前提：线程一定会执行完
+                    if(slot->thread.joinable())
+                        slot->thread.join(); // 等待任务结束， 前提：线程一定会执行完
+                }
+            }
+
+            // 运行期调整线程数量上下限、扩容滞后和空闲退出时间，mode 不可修改
+            // 下限提高时由管理线程立即补足；上限降低时多出的线程做完手头任务后退出
+            // per_node 方式下 min_threads 不小于节点数
+            void configure(const threadpool_options &opts) {
+                int min = std::max(1, static_cast<int>(std::min<unsigned>(opts.min_threads, THREADPOOL_SLOT_LIMIT)));
+                if (_placement == placement_policy::per_node)
+                    min = std::max(min, node_count());
+                int max = std::max(min, static_cast<int>(std::min<unsigned>(opts.max_threads, THREADPOOL_SLOT_LIMIT)));
+                _grow_delay = std::chrono::duration_cast<std::chrono::nanoseconds>(opts.grow_delay).count();
+                _idle_timeout = std::chrono::duration_cast<std::chrono::nanoseconds>(opts.idle_timeout).count();
+                _overflow = opts.overflow;
+                _capacity = opts.capacity;
+                _metrics = opts.metrics;
+                _wait_strategy = opts.wait;
+                _spin_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(opts.spin_time).count();
+                _max_spinners = static_cast<int>(std::min<unsigned>(opts.max_spinners, THREADPOOL_SLOT_LIMIT));
+                _max = max;
+                _min = min;
+                request_grow();
+                {
+                    std::lock_guard<std::mutex> lock{ _lock };
+                    _config_gen++;
                 }
+                _task_cv.notify_all(); // 让空闲线程按新的参数重新计时
+                { std::lock_guard<std::mutex> lock{ _space_lock }; }
+                _space_cv.notify_all(); // 容量可能变大
             }
 
+            threadpool_options options() const {
+                threadpool_options opts;
+                opts.min_threads = _min;
+                opts.max_threads = _max;
+                opts.grow_delay = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::nanoseconds(_grow_delay));
+                opts.idle_timeout = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::nanoseconds(_idle_timeout));
+                opts.mode = _mode;
+                opts.placement = _placement;
+                opts.cpu_sets = _cpu_sets;
+                opts.capacity = _capacity;
+                opts.overflow = _overflow;
+                opts.metrics = _metrics;
+                opts.wait = _wait_strategy;
+                opts.spin_time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::nanoseconds(_spin_ns));
+                opts.max_spinners = _max_spinners;
+                return opts;
+            }
+
+            // 线程池使用的 NUMA 节点数，placement 为 none 时为 0
+            int node_count() const { return static_cast<int>(_topology.nodes.size()); }
+            // 线程池使用的 NUMA 拓扑
+            const numa_topology& topology() const { return _topology; }
+
         public:
             // 提交一个任务
             // 调用.get()获取返回值会等待任务执行完,获取返回值
             // 有两种方法可以实现调用类成员，
             // 一种是使用   bind： .commit(std::bind(&Dog::sayHello, &dog));
             // 一种是用   mem_fn： .commit(std::mem_fn(&Dog::sayHello), this)
+            // 工作窃取模式下，工作线程内提交的任务进入本线程私有队列，其他线程提交的进入共享注入队列
             template<class F, class... Args>
             auto commit(F&& f, Args&&... args) ->std::future<decltype(f(args...))> {
-                if (!_run)    // stoped ??
+                return commit(priority::normal, std::forward<F>(f), std::forward<Args>(args)...);
+            }
+
+            // 按指定优先级提交一个任务: .commit(priority::high, handler, req)
+            // 工作线程优先取高优先级任务，低优先级任务由 THREADPOOL_STARVATION_LIMIT 保证不被饿死
+            template<class F, class... Args>
+            auto commit(priority level, F&& f, Args&&... args) ->std::future<decltype(f(args...))> {
+                return commit_to(level, nullptr, std::forward<F>(f), std::forward<Args>(args)...);
+            }
+
+            // 投递到指定 NUMA 节点: .commit(numa_node{ 1 }, fn, args...)，按 normal 优先级执行
+            // 节点不存在或 placement 为 none 时按普通任务处理
+            template<class F, class... Args>
+            auto commit(numa_node node, F&& f, Args&&... args) ->std::future<decltype(f(args...))> {
+                return commit_to(priority::normal, node_lane(node), std::forward<F>(f), std::forward<Args>(args)...);
+            }
+
+            // 提交一个不关心结果的任务，不创建 future，任务抛出的异常被丢弃
+            // 支持成员函数指针： .post(&Dog::sayHello, &dog)
+            template<class F, class... Args>
+            void post(F&& f, Args&&... args) {
+                post(priority::normal, std::forward<F>(f), std::forward<Args>(args)...);
+            }
+
+            template<class F, class... Args>
+            void post(priority level, F&& f, Args&&... args) {
+                post_to(level, nullptr, std::forward<F>(f), std::forward<Args>(args)...);
+            }
+
+            template<class F, class... Args>
+            void post(numa_node node, F&& f, Args&&... args) {
+                post_to(priority::normal, node_lane(node), std::forward<F>(f), std::forward<Args>(args)...);
+            }
+
+            // 不阻塞的提交: 队列已满时不按 overflow 策略处理，直接返回空并计入 rejected
+            template<class F, class... Args>
+            auto try_commit(F&& f, Args&&... args) ->std::optional<std::future<decltype(f(args...))>> {
+                return try_commit(priority::normal, std::forward<F>(f), std::forward<Args>(args)...);
+            }
+
+            // 被拒绝时不会移动 f 和 args，调用者可以稍后重试
+            template<class F, class... Args>
+            auto try_commit(priority level, F&& f, Args&&... args) ->std::optional<std::future<decltype(f(args...))>> {
+                if (!_run)
                     throw std::runtime_error("commit on ThreadPool is stopped.");
 
-                using RetType = decltype(f(args...)); // typename std::result_of<F(Args...)>::type, 函数 f 的返回值类型
-                auto task = std::make_shared<std::packaged_task<RetType()>>(
-                    std::bind(std::forward<F>(f), std::forward<Args>(args)...)
-                    ); // 把函数入口及参数,打包(绑定)
-                std::future<RetType> future = task->get_future();
-                // 添加任务到队列
-                {
-                    // 对当前块的语句加锁  lock_guard 是 mutex 的 stack 封装类，构造的时候 lock()，析构的时候 unlock()
-                    std::lock_guard<std::mutex> lock{ _lock };
-                    _tasks.emplace([task]() { // push(task_t{...}) 放到队列后面
-                                       (*task)();
-                                   });
-                }
-#ifdef THREADPOOL_AUTO_GROW
-                if (_idlThrNum < 1 && _pool.size() < THREADPOOL_MAX_NUM)
-                    addThread(1);
-#endif // !THREADPOOL_AUTO_GROW
-                _task_cv.notify_one(); // 唤醒一个线程执行
+                using RetType = decltype(f(args...));
+                std::promise<RetType> promise{ std::allocator_arg, pool_allocator<RetType>() };
+                std::future<RetType> future = promise.get_future();
+                bool accepted = try_offer(level, [&]() -> task_t {
+                    return detail::packaged<RetType, typename std::decay<F>::type, std::tuple<typename std::decay<Args>::type...>>{
+                        std::move(promise), std::forward<F>(f), std::make_tuple(std::forward<Args>(args)...) };
+                });
+                if (!accepted)
+                    return std::nullopt;
+                return future;
+            }
+
+            // 不阻塞的 post，队列已满时返回 false
+            template<class F, class... Args>
+            bool try_post(F&& f, Args&&... args) {
+                return try_post(priority::normal, std::forward<F>(f), std::forward<Args>(args)...);
+            }
 
+            template<class F, class... Args>
+            bool try_post(priority level, F&& f, Args&&... args) {
+                if (!_run)
+                    throw std::runtime_error("post on ThreadPool is stopped.");
+
+                return try_offer(level, [&]() -> task_t {
+                    return detail::invoker<typename std::decay<F>::type, std::tuple<typename std::decay<Args>::type...>>{
+                        std::forward<F>(f), std::make_tuple(std::forward<Args>(args)...) };
+                });
+            }
+
+            // 提交一个任务，返回可挂续延的 utils::thread::future
+            // 续延在前一步完成时提交到本线程池执行，流水线的各步之间不占用等待的线程:
+            // pool.async(decode, buf).then(handle).then(reply);
+            // 线程池必须比挂在其上的续延活得久
+            template<class F, class... Args>
+            auto async(F&& f, Args&&... args) ->future<decltype(f(args...))> {
+                return async(priority::normal, std::forward<F>(f), std::forward<Args>(args)...);
+            }
+
+            template<class F, class... Args>
+            auto async(priority level, F&& f, Args&&... args) ->future<decltype(f(args...))> {
+                if (!_run)
+                    throw std::runtime_error("async on ThreadPool is stopped.");
+
+                using RetType = decltype(f(args...));
+                utils::thread::promise<RetType> result{ get_executor() };
+                future<RetType> pending = result.get_future();
+                offer(level, detail::packaged<RetType, typename std::decay<F>::type, std::tuple<typename std::decay<Args>::type...>, utils::thread::promise<RetType>>{
+                        std::move(result), std::forward<F>(f), std::make_tuple(std::forward<Args>(args)...) });
+                return pending;
+            }
+
+            // 把任务以 normal 优先级提交到本线程池的执行器，future 的续延通过它调度
+            // 在工作线程上完成的 future，其续延进入该线程私有队列，紧接着在同一线程执行，数据还在缓存里
+            executor get_executor() {
+                return executor{ this, [](void *pool, task_t &&fn) {
+                                           static_cast<threadpool*>(pool)->submit(priority::normal, std::move(fn));
+                                       } };
+            }
+
+#ifdef THREADPOOL_COROUTINE
+            // co_await pool.schedule(): 当前协程转到工作线程上继续执行
+            coro::schedule_awaiter schedule() { return coro::schedule_awaiter{ get_executor() }; }
+
+            // co_await pool.yield(): 让出工作线程，当前协程排到共享队列末尾，已经在排队的任务先执行
+            // 与 schedule() 不同，不进入本线程私有队列，否则会被本线程立即取回
+            coro::schedule_awaiter yield() {
+                return coro::schedule_awaiter{ executor{ this, [](void *pool, task_t &&fn) {
+                                                   auto *self = static_cast<threadpool*>(pool);
+                                                   self->submit(priority::normal, std::move(fn), &self->_lanes[static_cast<int>(priority::normal)]);
+                                               } } };
+            }
+
+            // 在线程池上启动协程，不等待结果；返回的 future 可以忽略，也可以 then/get/co_await
+            template<class T>
+            future<T> spawn(coro::task<T> t) { return coro::spawn(get_executor(), std::move(t)); }
+#endif // THREADPOOL_COROUTINE
+
+            // 延迟 delay 后执行，不占用工作线程等待；用返回的句柄取消
+            // 与 post 一样不返回结果，异常被丢弃: auto h = pool.commit_after(std::chrono::seconds(3), on_timeout, id);
+            template<class Rep, class Period, class F, class... Args>
+            timer_handle commit_after(std::chrono::duration<Rep, Period> delay, F&& f, Args&&... args) {
+                return schedule_timer(delay, std::chrono::nanoseconds(0), std::forward<F>(f), std::forward<Args>(args)...);
+            }
+
+            // 在指定时间点执行，任意时钟均可，按提交时两个时钟的差值换算成延迟
+            template<class Clock, class Duration, class F, class... Args>
+            timer_handle commit_at(std::chrono::time_point<Clock, Duration> when, F&& f, Args&&... args) {
+                return commit_after(when - Clock::now(), std::forward<F>(f), std::forward<Args>(args)...);
+            }
+
+            // 每隔 period 执行一次，第一次在 period 之后；上一次还没执行完时跳过本次，直到句柄取消或线程池析构
+            template<class Rep, class Period, class F, class... Args>
+            timer_handle commit_every(std::chrono::duration<Rep, Period> period, F&& f, Args&&... args) {
+                return schedule_timer(period, period, std::forward<F>(f), std::forward<Args>(args)...);
+            }
+
+            // 批量提交: 对 [begin, end) 中的每个元素调用 fn(*it)
+            // 整批任务只加一次锁入队，按任务数量唤醒线程，全部执行完后返回的 future 就绪
+            // 任一元素抛出异常时，future 得到第一个异常
+            template<class Iter, class F>
+            std::future<void> commit_bulk(Iter begin, Iter end, F&& fn) {
+                if (!_run)
+                    throw std::runtime_error("commit on ThreadPool is stopped.");
+
+                using state_t = detail::bulk_state<typename std::decay<F>::type>;
+                std::size_t count = std::distance(begin, end);
+                // 生成第一个任务之前由这里持有，offer 在此之前抛出 (拒绝或线程池停止) 时随之释放
+                std::unique_ptr<state_t> owner(new state_t(std::forward<F>(fn), count));
+                state_t *state = owner.get();
+                std::future<void> future = state->promise.get_future();
+                if (count == 0) {
+                    state->promise.set_value();
+                    return future;
+                }
+                offer(priority::normal, count, [state, &owner, &begin]() {
+                                                   owner.release();     // 之后由任务在最后一个完成时释放
+                                                   return detail::bulk_item<state_t, Iter>(state, begin++);
+                                               });
                 return future;
             }
 
+            // 并行循环: 对 [first, last) 中的每个下标调用 fn(i)
+            // 区间按 grain 个下标切块 (0 表示按线程数自动切分)，调用线程自己也领取分块执行，
+            // 全部完成后才返回，在工作线程内调用也不会死锁；有分块抛出异常时重新抛出第一个异常
+            template<class Index, class F>
+            void parallel_for(Index first, Index last, F&& fn, std::size_t grain = 0) {
+                grain = chunk_size(first, last, grain);
+                auto body = [&](std::size_t chunk) {
+                                Index b = first + static_cast<Index>(chunk * grain);
+                                Index e = static_cast<std::size_t>(last - b) > grain ? b + static_cast<Index>(grain) : last;
+                                for (Index i = b; i < e; ++i)
+                                    fn(i);
+                            };
+                run_chunks(first, last, grain, body);
+            }
+
+            // 并行归约: 返回 reduce(...reduce(reduce(init, map(first)), map(first + 1))..., map(last - 1))
+            // 每个分块先在本地归约，最后按分块顺序合并，reduce 需满足结合律
+            template<class Index, class T, class Map, class Reduce>
+            T parallel_reduce(Index first, Index last, T init, Map&& map, Reduce&& reduce, std::size_t grain = 0) {
+                grain = chunk_size(first, last, grain);
+                std::vector<std::optional<T>> partial(first < last ? (static_cast<std::size_t>(last - first) + grain - 1) / grain : 0);
+                auto body = [&](std::size_t chunk) {
+                                Index b = first + static_cast<Index>(chunk * grain);
+                                Index e = static_cast<std::size_t>(last - b) > grain ? b + static_cast<Index>(grain) : last;
+                                T acc = map(b);
+                                for (Index i = b + 1; i < e; ++i)
+                                    acc = reduce(std::move(acc), map(i));
+                                partial[chunk].emplace(std::move(acc));
+                            };
+                run_chunks(first, last, grain, body);
+                for (auto &p : partial)
+                    init = reduce(std::move(init), std::move(*p));
+                return init;
+            }
+
+            // 队列满时各种处理的累计次数
+            overflow_stats overflow_counters() const {
+                overflow_stats stats;
+                stats.rejected = _rejected;
+                stats.blocked = _blocked;
+                stats.caller_runs = _caller_runs;
+                stats.discarded = _discarded;
+                return stats;
+            }
+
             //空闲线程数量
             int idlCount() { return _idlThrNum; }
             //线程数量
-            int thrCount() { return _pool.size(); }
+            int thrCount() { return _live; }
             // 队列中任务数量
-            int taskCount() { return _tasks.size(); }
+            int taskCount() { return _pending; }
+            // 指定优先级任务的排队耗时分布 (纳秒)，用于确认高优先级的 p99 不受批量任务影响
+            histogram_snapshot wait_stats(priority level) const { return _wait[static_cast<int>(level)].snapshot(); }
+
+            // 统计快照，只读原子量，不加锁，不影响工作线程
+            // reset_peak 为 true 时把最高水位重置为当前排队数，便于按采集周期观察
+            threadpool_stats stats(bool reset_peak = false) {
+                threadpool_stats s;
+                s.threads = _live;
+                s.idle = _idlThrNum;
+                s.pending = _pending;
+                s.peak_pending = reset_peak ? _peak_pending.exchange(s.pending) : _peak_pending.load();
+                s.submitted = _submitted;
+                for (int i = 0; i < priority_count; ++i)
+                    s.wait[i] = _wait[i].snapshot();
+                s.overflow = overflow_counters();
+                for (int i = 0, num = _qnum; i < num; ++i) {
+                    worker_slot &w = slot(i);
+                    worker_stats ws;
+                    ws.index = i;
+                    ws.active = w.active;
+                    ws.node = w.node;
+                    ws.executed = w.executed.load(std::memory_order_relaxed);
+                    ws.steals = w.steals.load(std::memory_order_relaxed);
+                    ws.idle_ns = w.idle_ns.load(std::memory_order_relaxed);
+                    ws.exec = w.exec.snapshot();
+                    s.executed += ws.executed;
+                    s.steals += ws.steals;
+                    s.exec.merge(ws.exec);
+                    s.workers.push_back(std::move(ws));
+                }
+                return s;
+            }
 
 #ifndef THREADPOOL_AUTO_GROW
         private:
 #endif // !THREADPOOL_AUTO_GROW
             // 添加指定数量的线程
             void addThread(unsigned short size) {
-                // 增加线程数量,但不超过 预定义数量 THREADPOOL_MAX_NUM
-                for (; _pool.size() < THREADPOOL_MAX_NUM && size > 0; --size) {
-                    _pool.emplace_back( [this]{ // 工作线程函数
-                                            while (_run) {
-                                                task_t task; // 获取一个待执行的 task
-                                                {
-                                                    // unique_lock 相比 lock_guard 的好处是：可以随时 unlock() 和 lock()
-                                                    std::unique_lock<std::mutex> lock{ _lock };
-                                                    _task_cv.wait(lock, [this]{
-                                                                            return !_run || !_tasks.empty();
-                                                                        }); // wait 直到有 task
-                                                    if (!_run && _tasks.empty())
-                                                        return;
-                                                    task = move(_tasks.front()); // 按先进先出从队列取一个 task
-                                                    _tasks.pop();
-                                                }
-                                                _idlThrNum--;
-                                                task(); // 执行任务
-                                                _idlThrNum++;
-                                            }
-                                        });
-                    _idlThrNum++;
+                std::lock_guard<std::mutex> lock{ _grow_lock };
+                // 增加线程数量,但不超过 上限 max_threads
+                for (; _live < _max && size > 0; --size)
+                    spawn();
+            }
+
+        private:
+            // target 不为空时放入该队列 (NUMA 节点队列)，否则按优先级和调用线程选择队列
+            template<class F, class... Args>
+            auto commit_to(priority level, lane *target, F&& f, Args&&... args) ->std::future<decltype(f(args...))> {
+                if (!_run)    // stoped ??
+                    throw std::runtime_error("commit on ThreadPool is stopped.");
+
+                using RetType = decltype(f(args...)); // typename std::result_of<F(Args...)>::type, 函数 f 的返回值类型
+                // 共享状态从线程本地内存块缓存分配，函数和参数直接放进 task 的内联存储，小任务提交不调用 malloc
+                std::promise<RetType> promise{ std::allocator_arg, pool_allocator<RetType>() };
+                std::future<RetType> future = promise.get_future();
+                // 添加任务到队列
+                offer(level, detail::packaged<RetType, typename std::decay<F>::type, std::tuple<typename std::decay<Args>::type...>>{
+                        std::move(promise), std::forward<F>(f), std::make_tuple(std::forward<Args>(args)...) }, target);
+
+                return future;
+            }
+
+            template<class F, class... Args>
+            void post_to(priority level, lane *target, F&& f, Args&&... args) {
+                if (!_run)
+                    throw std::runtime_error("post on ThreadPool is stopped.");
+
+                offer(level, detail::invoker<typename std::decay<F>::type, std::tuple<typename std::decay<Args>::type...>>{
+                        std::forward<F>(f), std::make_tuple(std::forward<Args>(args)...) }, target);
+            }
+
+            template<class Delay, class Period, class F, class... Args>
+            timer_handle schedule_timer(Delay delay, Period period, F&& f, Args&&... args) {
+                if (!_run)
+                    throw std::runtime_error("commit on ThreadPool is stopped.");
+                std::call_once(_timer_once, [this] { _timer = std::make_shared<timer_wheel>(get_executor()); });
+                return _timer->schedule(std::chrono::duration_cast<std::chrono::nanoseconds>(delay).count(),
+                                        std::chrono::duration_cast<std::chrono::nanoseconds>(period).count(),
+                                        detail::invoker<typename std::decay<F>::type, std::tuple<typename std::decay<Args>::type...>>{
+                                            std::forward<F>(f), std::make_tuple(std::forward<Args>(args)...) });
+            }
+
+            // NUMA 节点对应的队列，没有该节点时返回 nullptr
+            lane* node_lane(numa_node node) {
+                int index = _topology.index_of_node(node.id);
+                return index < 0 ? nullptr : &_nodes[index].tasks;
+            }
+
+            // pinned 方式下各槽位绑定的 CPU 集合
+            static std::vector<cpu_set> pinned_sets(const threadpool_options &opts) {
+                if (opts.placement != placement_policy::pinned || !opts.cpu_sets.empty())
+                    return opts.cpu_sets;
+                std::vector<cpu_set> sets;
+                for (int cpu : detail::allowed_cpus())
+                    sets.push_back(cpu_set{ cpu });
+                return sets;
+            }
+
+            // 队列里还能放下 count 个任务；队列为空时总能放下，超大的批量提交不会永远等待
+            // 与入队不是原子的，并发提交时可能略微超过上限
+            bool has_space(std::size_t count) const {
+                std::size_t cap = _capacity.load(std::memory_order_relaxed);
+                int pending = _pending;
+                return cap == 0 || pending <= 0 || static_cast<std::size_t>(pending) + count <= cap;
+            }
+
+            void offer(priority level, task_t &&task, lane *target = nullptr, const void *tag = nullptr) {
+                offer(level, 1, [&task]() { return std::move(task); }, target, tag);
+            }
+
+            // 用户提交的入口: 按 capacity 和 overflow 策略接纳任务
+            // 续延、定时器、协程恢复和 parallel_for 的辅助任务直接走 submit，不受容量限制，否则会丢失或死锁
+            template<class Make>
+            void offer(priority level, std::size_t count, Make &&make, lane *target = nullptr, const void *tag = nullptr) {
+                if (has_space(count)) {
+                    submit(level, count, make, target, tag);
+                    return;
+                }
+                overflow_policy policy = _overflow;
+                if (policy == overflow_policy::block && context().pool == this)
+                    policy = overflow_policy::caller_runs;  // 工作线程等待空位可能永远等不到
+                switch (policy) {
+                case overflow_policy::reject:
+                    _rejected += count;
+                    throw queue_full();
+                case overflow_policy::caller_runs:
+                    _caller_runs += count;
+                    for (std::size_t i = 0; i < count; ++i) {
+                        task_t task = make();
+                        task();
+                    }
+                    return;
+                case overflow_policy::discard_oldest:
+                    discard(count);
+                    break;
+                case overflow_policy::block:
+                    wait_space(count);
+                    break;
+                }
+                submit(level, count, make, target, tag);
+            }
+
+            // try_commit/try_post 的入口: 检查容量和占用 _pending 是一次 CAS，并发提交也不会超过上限
+            // 放不下时返回 false 并计入 rejected，不按 overflow 策略处理；只有被接纳时才调用 make() 生成任务
+            template<class Make>
+            bool try_offer(priority level, Make &&make) {
+                std::size_t cap = _capacity.load(std::memory_order_relaxed);
+                int pending = _pending;
+                do {
+                    if (cap != 0 && pending > 0 && static_cast<std::size_t>(pending) + 1 > cap) {
+                        _rejected++;
+                        return false;
+                    }
+                } while (!_pending.compare_exchange_weak(pending, pending + 1));
+                submit(level, 1, make, nullptr, nullptr, true);
+                return true;
+            }
+
+            // 阻塞到队列里能放下 count 个任务或线程池停止
+            void wait_space(std::size_t count) {
+                std::unique_lock<std::mutex> lock{ _space_lock };
+                _space_waiters++;
+                if (!has_space(count)) {
+                    _blocked++;
+                    _space_cv.wait(lock, [this, count] { return !_run || has_space(count); });
+                }
+                _space_waiters--;
+                if (!_run)
+                    throw std::runtime_error("commit on ThreadPool is stopped.");
+            }
+
+            // 丢弃最旧的 count 个任务，依次从 低优先级 -> 普通 -> NUMA 节点 -> 各线程私有队列头部 -> 高优先级 中取
+            // 被丢弃的任务在锁外析构，future 得到 broken_promise
+            void discard(std::size_t count) {
+                for (std::size_t i = 0; i < count; ++i) {
+                    job j;
+                    bool found = take(priority::low, j) || take(priority::normal, j);
+                    for (int n = 0; !found && n < node_count(); ++n)
+                        found = take(_nodes[n].tasks, j);
+                    for (int q = 0, num = _qnum; !found && q < num; ++q) {
+                        worker_slot &victim = slot(q);
+                        std::lock_guard<std::mutex> lock{ victim.lock };
+                        if (!victim.tasks.empty()) {
+                            j = std::move(victim.tasks.front());
+                            victim.tasks.pop_front();
+                            found = true;
+                        }
+                    }
+                    if (!found)
+                        found = take(priority::high, j);
+                    if (!found)
+                        return;
+                    _pending--;
+                    _discarded++;
+                }
+            }
+
+            // 从所有队列中移除带 tag 的任务，返回移除的数量；被移除的任务在锁外析构
+            std::size_t purge(const void *tag) {
+                std::vector<job> removed;
+                auto match = [tag](const job &j) { return j.tag == tag; };
+                auto sink = [&removed](job &&j) { removed.push_back(std::move(j)); };
+                auto purge_lane = [&](lane &l) {
+                    if (l.size < 1)
+                        return;
+                    std::lock_guard<std::mutex> lock{ l.lock };
+                    l.size -= static_cast<int>(l.tasks.remove_if(match, sink));
+                };
+                for (auto &l : _lanes)
+                    purge_lane(l);
+                for (int n = 0; n < node_count(); ++n)
+                    purge_lane(_nodes[n].tasks);
+                for (int i = 0, num = _qnum; i < num; ++i) {
+                    worker_slot &w = slot(i);
+                    std::lock_guard<std::mutex> lock{ w.lock };
+                    w.tasks.remove_if(match, sink);
+                }
+                if (!removed.empty()) {
+                    _pending -= static_cast<int>(removed.size());
+                    release_space();
+                }
+                return removed.size();
+            }
+
+            // 当前线程是否为本线程池的工作线程
+            bool in_worker() const { return context().pool == this; }
+
+            // 当前线程是本线程池的工作线程时取一个任务执行，等待时帮忙，工作线程不会干等
+            bool help_one() {
+                worker_context &ctx = context();
+                job j;
+                priority level;
+                if (ctx.pool != this || !pop(ctx.index, j, level))
+                    return false;
+                j.fn();
+                detail::bump(slot(ctx.index).executed);
+                return true;
+            }
+
+            // 任务出队后唤醒等待空位的提交者
+            // _pending 与 _space_waiters 均为顺序一致的原子量，与 wakeup() 的做法相同，不会丢失唤醒
+            void release_space() {
+                if (_space_waiters.load() < 1)
+                    return;
+                { std::lock_guard<std::mutex> lock{ _space_lock }; }
+                _space_cv.notify_all();
+            }
+
+            void submit(priority level, task_t &&task, lane *target = nullptr) {
+                submit(level, 1, [&task]() { return std::move(task); }, target);
+            }
+
+            // 一次加锁放入 count 个任务，每个任务由 make() 生成
+            // reserved 为 true 时调用者已经为这些任务增加过 _pending (try_offer)
+            template<class Make>
+            void submit(priority level, std::size_t count, Make &&make, lane *target = nullptr, const void *tag = nullptr,
+                        bool reserved = false) {
+                enqueue(level, count, make, target, tag, reserved);
+#ifdef THREADPOOL_AUTO_GROW
+                if (_pending > _idlThrNum && _live < _max)
+                    request_grow();
+#endif // !THREADPOOL_AUTO_GROW
+                wakeup(count); // 唤醒线程执行
+            }
+
+            // 通知管理线程检查线程数量，已有未处理的请求时什么也不做
+            void request_grow() {
+                if (_grow_request.load(std::memory_order_relaxed) || _grow_request.exchange(true))
+                    return;
+                { std::lock_guard<std::mutex> lock{ _manage_lock }; }
+                _manage_cv.notify_one();
+            }
+
+            // 启动一个工作线程，优先复用已退出线程的槽位，调用者持有 _grow_lock
+            void spawn() {
+                int index = 0;
+                int num = _qnum;
+                while (index < num && _pool[index]->active)
+                    ++index;
+                if (index == num) {
+                    _pool.emplace_back(new worker_slot);
+                    _slots[index].store(_pool.back().get());
+                    _qnum++;     // 先发布槽位，其他线程才能从中窃取
+                }
+                worker_slot &w = *_pool[index];
+                if (w.thread.joinable())
+                    w.thread.join();    // 上一个使用该槽位的线程已经退出
+                place(index, w);
+                w.active = true;
+                _live++;
+                _idlThrNum++;
+                w.thread = std::thread(&threadpool::worker, this, index);
+            }
+
+            // 按 placement 为槽位选择 NUMA 节点和要绑定的 CPU，调用者持有 _grow_lock
+            void place(int index, worker_slot &w) {
+                int node = -1;
+                w.cpus.clear();
+                if (_placement == placement_policy::pinned) {
+                    if (!_cpu_sets.empty()) {
+                        w.cpus = _cpu_sets[index % _cpu_sets.size()];
+                        node = w.cpus.empty() ? -1 : _topology.index_of_cpu(w.cpus.front());
+                    }
+                } else if (_placement != placement_policy::none) {
+                    // 放到存活线程最少的节点，线程均匀分布，per_node 方式下补足空节点
+                    for (int i = 0; i < node_count(); ++i)
+                        if (node < 0 || _nodes[i].live < _nodes[node].live)
+                            node = i;
+                    w.cpus = _topology.nodes[node].cpus;
+                }
+                w.node = node;
+                if (node >= 0)
+                    _nodes[node].live++;
+            }
+
+            // 管理线程: 补足 min_threads；积压任务多于空闲线程的状态持续 grow_delay 后，按差额扩容到不超过 max_threads
+            void manager() {
+                std::int64_t backlog_since = 0;
+                std::unique_lock<std::mutex> lock{ _manage_lock };
+                while (_run) {
+                    if (backlog_since) {
+                        std::int64_t left = backlog_since + _grow_delay - detail::now_ns();
+                        if (left > 0)
+                            _manage_cv.wait_for(lock, std::chrono::nanoseconds(left));
+                    } else {
+                        _manage_cv.wait(lock, [this]{ return !_run || _grow_request; });
+                    }
+                    _grow_request = false;
+                    if (!_run)
+                        break;
+
+                    lock.unlock();
+                    {
+                        std::lock_guard<std::mutex> grow{ _grow_lock };
+                        while (_live < _min)
+                            spawn();
+                        int lack = std::min(_pending - _idlThrNum, _max - _live);
+                        if (lack < 1) {
+                            backlog_since = 0;
+                        } else {
+                            std::int64_t now = detail::now_ns();
+                            if (!backlog_since)
+                                backlog_since = now;
+                            if (now - backlog_since >= _grow_delay) {
+                                while (lack-- > 0)
+                                    spawn();
+                                backlog_since = 0;
+                            }
+                        }
+                    }
+                    lock.lock();
+                }
+            }
+
+            // 存活线程数减一，但不低于 floor；per_node 方式下每个节点至少保留一个线程
+            bool retire(int floor, worker_slot &w) {
+                int node = w.node;
+                std::atomic<int> *node_live = node >= 0 ? &_nodes[node].live : nullptr;
+                if (node_live) {
+                    int keep = _placement == placement_policy::per_node ? 1 : 0;
+                    int n = *node_live;
+                    do {
+                        if (n <= keep)
+                            return false;
+                    } while (!node_live->compare_exchange_weak(n, n - 1));
+                }
+                int live = _live;
+                while (live > floor) {
+                    if (_live.compare_exchange_weak(live, live - 1)) {
+                        _idlThrNum--;
+                        return true;
+                    }
+                }
+                if (node_live)
+                    (*node_live)++;
+                return false;
+            }
+
+            // 线程退出前把私有队列里剩下的任务转交给共享队列
+            void drain(worker_slot &w) {
+                int moved = 0;
+                {
+                    std::lock_guard<std::mutex> lock{ w.lock };
+                    lane &l = _lanes[static_cast<int>(priority::normal)];
+                    std::lock_guard<std::mutex> guard{ l.lock };
+                    for (; !w.tasks.empty(); ++moved) {
+                        l.tasks.push_back(std::move(w.tasks.front()));
+                        w.tasks.pop_front();
+                    }
+                    l.size += moved;
+                }
+                // 退出的线程可能刚好消耗了一次唤醒，把它传给别的线程
+                if (moved > 0 || _pending > 0)
+                    wakeup(std::max(moved, 1));
+            }
+
+            static worker_context& context() {
+                static thread_local worker_context ctx;
+                return ctx;
+            }
+
+            worker_slot& slot(int index) { return *_slots[index].load(std::memory_order_acquire); }
+
+            // 把任务放入合适的队列
+            // 工作窃取模式下，工作线程内提交的 normal 任务进入本线程私有队列，其余进入对应优先级的共享队列
+            template<class Make>
+            void enqueue(priority level, std::size_t count, Make &make, lane *target, const void *tag, bool reserved) {
+                std::int64_t now = _metrics.load(std::memory_order_relaxed) ? detail::now_ns() : 0;
+                worker_context &ctx = context();
+                if (target) {
+                    std::lock_guard<std::mutex> lock{ target->lock };
+                    for (std::size_t i = 0; i < count; ++i)
+                        target->tasks.push_back(job{ make(), now, tag });
+                    target->size += count;
+                } else if (level == priority::normal && _mode == schedule_mode::work_stealing && ctx.pool == this) {
+                    worker_slot &q = slot(ctx.index);
+                    std::lock_guard<std::mutex> lock{ q.lock };
+                    for (std::size_t i = 0; i < count; ++i)
+                        q.tasks.push_back(job{ make(), now, tag });
+                } else {
+                    lane &l = _lanes[static_cast<int>(level)];
+                    // 对当前块的语句加锁  lock_guard 是 mutex 的 stack 封装类，构造的时候 lock()，析构的时候 unlock()
+                    std::lock_guard<std::mutex> lock{ l.lock };
+                    for (std::size_t i = 0; i < count; ++i)
+                        l.tasks.push_back(job{ make(), now, tag });
+                    l.size += count;
+                }
+                int pending = reserved ? _pending.load() : _pending += count;
+                _submitted.fetch_add(count, std::memory_order_relaxed);
+                int peak = _peak_pending.load(std::memory_order_relaxed);
+                while (pending > peak && !_peak_pending.compare_exchange_weak(peak, pending, std::memory_order_relaxed))
+                    ;
+            }
+
+            // 只有确实有线程在睡眠时才去碰 _lock 和 futex
+            // _pending 与 _sleepers 均为顺序一致的原子量，工作线程先登记 _sleepers 再检查 _pending，
+            // 提交者先增加 _pending 再检查 _sleepers，两者至少有一方能看到对方，不会丢失唤醒
+            // 自旋中的线程会自己发现新任务，只唤醒超出自旋线程数的部分；自旋线程退出时同样先减 _spinners 再检查 _pending
+            void wakeup(std::size_t count = 1) {
+                int spinners = _spinners;
+                if (spinners > 0) {
+                    if (count <= static_cast<std::size_t>(spinners))
+                        return;
+                    count -= spinners;
+                }
+                int sleepers = _sleepers;
+                if (sleepers < 1)
+                    return;
+                { std::lock_guard<std::mutex> lock{ _lock }; }
+                if (count >= static_cast<std::size_t>(sleepers)) {
+                    _task_cv.notify_all();
+                } else {
+                    for (std::size_t i = 0; i < count; ++i)
+                        _task_cv.notify_one();
+                }
+            }
+
+            // spin_then_park 方式下睡眠前先自旋等待任务，返回 true 表示等到了任务
+            // 先 pause 自旋 spin_time，再 yield 同样长时间；超过 max_spinners 个线程在自旋时直接返回
+            bool spin() {
+                if (_wait_strategy.load(std::memory_order_relaxed) != wait_strategy::spin_then_park)
+                    return false;
+                int spinners = _spinners;
+                do {
+                    if (spinners >= _max_spinners)
+                        return false;
+                } while (!_spinners.compare_exchange_weak(spinners, spinners + 1));
+
+                // 只有一个 CPU 时 pause 自旋只会挡住提交者，直接进入 yield 阶段
+                static const bool single_cpu = std::thread::hardware_concurrency() < 2;
+                std::int64_t spin_ns = _spin_ns;
+                std::int64_t deadline = detail::now_ns() + spin_ns;
+                bool yielding = single_cpu;
+                for (unsigned i = 1; _run && _pending < 1; ++i) {
+                    if (yielding)
+                        std::this_thread::yield();
+                    else
+                        THREADPOOL_CPU_RELAX();
+                    if (i % 64 == 0 && detail::now_ns() >= deadline) {
+                        if (yielding)
+                            break;
+                        yielding = true;
+                        deadline += spin_ns;
+                    }
+                }
+                _spinners--;
+                int pending = _pending;
+                if (pending > 1)
+                    wakeup(pending - 1);    // 提交者因为有线程在自旋而没有唤醒别人，多出的任务交给其他线程
+                return pending > 0;
+            }
+
+            // 分块大小: 未指定时每个线程大约分到 4 块
+            template<class Index>
+            std::size_t chunk_size(Index first, Index last, std::size_t grain) {
+                if (grain > 0 || !(first < last))
+                    return grain > 0 ? grain : 1;
+                std::size_t n = static_cast<std::size_t>(last - first);
+                return std::max<std::size_t>(1, n / (std::max(thrCount(), 1) * 4));
+            }
+
+            template<class Index, class Body>
+            void run_chunks(Index first, Index last, std::size_t grain, Body &body) {
+                if (!(first < last))
+                    return;
+                std::size_t chunks = (static_cast<std::size_t>(last - first) + grain - 1) / grain;
+                if (chunks == 1 || !_run || thrCount() < 1) {
+                    for (std::size_t c = 0; c < chunks; ++c)
+                        body(c);
+                    return;
+                }
+                auto state = std::allocate_shared<detail::chunk_state>(pool_allocator<detail::chunk_state>(), chunks, body);
+                std::size_t helpers = std::min<std::size_t>(chunks - 1, thrCount());
+                submit(priority::normal, helpers, [&state]() {
+                                                      return task_t([state]{ state->run(); });
+                                                  });
+                state->run();
+                state->wait();
+                if (state->error)
+                    std::rethrow_exception(state->error);
+            }
+
+            // 从共享队列头部取一个任务
+            bool take(priority level, job &out) {
+                return take(_lanes[static_cast<int>(level)], out);
+            }
+
+            bool take(lane &l, job &out) {
+                if (l.size < 1)
+                    return false;
+                std::lock_guard<std::mutex> lock{ l.lock };
+                if (l.tasks.empty())
+                    return false;
+                out = std::move(l.tasks.front()); // 按先进先出从队列取一个 task
+                l.tasks.pop_front();
+                l.size--;
+                return true;
+            }
+
+            // 从本线程私有队列尾部取一个任务
+            bool take_local(worker_slot &q, job &out) {
+                if (_mode != schedule_mode::work_stealing)
+                    return false;
+                std::lock_guard<std::mutex> lock{ q.lock };
+                if (q.tasks.empty())
+                    return false;
+                out = std::move(q.tasks.back());
+                q.tasks.pop_back();
+                return true;
+            }
+
+            // 本线程所在 NUMA 节点的队列
+            bool take_node(worker_slot &q, job &out) {
+                int node = q.node;
+                return node >= 0 && take(_nodes[node].tasks, out);
+            }
+
+            // 其他节点的队列，只在本节点和共享队列都没有任务时才取
+            bool take_foreign(worker_slot &q, job &out) {
+                int home = q.node;
+                for (int i = 0; i < node_count(); ++i)
+                    if (i != home && take(_nodes[i].tasks, out))
+                        return true;
+                return false;
+            }
+
+            // 从其他线程私有队列头部窃取一个任务，先窃取同一 NUMA 节点的线程
+            bool steal(int index, job &out) {
+                if (_mode != schedule_mode::work_stealing)
+                    return false;
+                int num = _qnum;
+                int home = slot(index).node;
+                for (int pass = 0; pass < 2; ++pass) {
+                    for (int i = 1; i < num; ++i) {
+                        worker_slot &victim = slot((index + i) % num);
+                        if ((victim.node.load(std::memory_order_relaxed) == home) != (pass == 0))
+                            continue;
+                        std::unique_lock<std::mutex> lock{ victim.lock, std::try_to_lock };
+                        if (lock.owns_lock() && !victim.tasks.empty()) {
+                            out = std::move(victim.tasks.front());
+                            victim.tasks.pop_front();
+                            return true;
+                        }
+                    }
+                    if (home < 0)
+                        break;  // 不区分节点时一轮就遍历了所有线程
+                }
+                return false;
+            }
+
+            // 依次尝试: 高优先级 -> 本线程私有队列尾部 -> 本节点队列 -> 普通 -> 低优先级
+            //        -> 窃取其他线程私有队列头部 (先同节点) -> 其他节点队列
+            // 每 THREADPOOL_STARVATION_LIMIT 次倒过来先取低优先级
+            bool pop(int index, job &out, priority &level) {
+                if (_pending < 1)
+                    return false;
+                worker_slot &q = slot(index);
+                bool found;
+                if (++q.picks % THREADPOOL_STARVATION_LIMIT == 0) {
+                    found = (take(level = priority::low, out)
+                             || take(level = priority::normal, out)
+                             || take_node(q, out)
+                             || take_local(q, out)
+                             || take(level = priority::high, out));
+                } else {
+                    found = (take(level = priority::high, out)
+                             || (level = priority::normal, take_local(q, out))
+                             || take_node(q, out)
+                             || take(priority::normal, out)
+                             || take(level = priority::low, out));
+                }
+                if (!found && (steal(index, out) || take_foreign(q, out))) {
+                    level = priority::normal;
+                    detail::bump(q.steals);
+                    found = true;
+                }
+                if (found) {
+                    _pending--;
+                    release_space();
+                }
+                return found;
+            }
+
+            // 工作线程函数
+            // 空闲超过 idle_timeout (不为 0) 且线程数多于 min_threads 时退出；线程数多于 max_threads 时做完手头任务就退出
+            void worker(int index) {
+                context() = worker_context{ this, index };
+                worker_slot &w = slot(index);
+                if (!w.cpus.empty())
+                    detail::set_affinity(w.cpus);
+                while (true) {
+                    job j; // 获取一个待执行的 task
+                    priority level;
+                    if (pop(index, j, level)) {
+                        std::int64_t start = 0;
+                        if (j.queued && _metrics.load(std::memory_order_relaxed)) {
+                            start = detail::now_ns();
+                            _wait[static_cast<int>(level)].record(start - j.queued);
+                        }
+                        _idlThrNum--;
+                        j.fn(); // 执行任务
+                        _idlThrNum++;
+                        detail::bump(w.executed);
+                        if (start)
+                            w.exec.record(detail::now_ns() - start);
+                        if (_live > _max && _run && retire(_max, w))
+                            break;
+                        continue;
+                    }
+                    // unique_lock 相比 lock_guard 的好处是：可以随时 unlock() 和 lock()
+                    std::int64_t sleep = _metrics.load(std::memory_order_relaxed) ? detail::now_ns() : 0;
+                    if (spin()) {
+                        if (sleep)
+                            detail::bump(w.idle_ns, detail::now_ns() - sleep);
+                        continue;
+                    }
+                    std::unique_lock<std::mutex> lock{ _lock };
+                    _sleepers++;
+                    std::int64_t timeout = _idle_timeout;
+                    bool woken;
+                    if (timeout > 0) {
+                        woken = _task_cv.wait_for(lock, std::chrono::nanoseconds(timeout), [this]{
+                                                      return !_run || _pending > 0;
+                                                  }); // wait 直到有 task
+                    } else {
+                        // 不退出: 一直等到有任务；configure() 之后回到循环开头按新参数重新等待
+                        unsigned gen = _config_gen;
+                        _task_cv.wait(lock, [this, gen]{
+                                          return !_run || _pending > 0 || _config_gen != gen;
+                                      });
+                        woken = !_run || _pending > 0;
+                    }
+                    _sleepers--;
+                    lock.unlock();
+                    if (sleep)
+                        detail::bump(w.idle_ns, detail::now_ns() - sleep);
+                    if (!_run && _pending < 1)
+                        return;
+                    if (!woken && timeout > 0 && _run && retire(_min, w))
+                        break;
                 }
+                drain(w);
+                w.active = false;
             }
         };
     }  // thread
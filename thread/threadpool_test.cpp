@@ -0,0 +1,112 @@
+// 线程池容量与溢出策略测试，失败时返回非 0
+//     g++ -std=c++17 -O2 -I.. threadpool_test.cpp -o threadpool_test -pthread
+//     ./threadpool_test
+
+#include <cstdio>
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <vector>
+#include <thread>
+
+#include "threadpool.hpp"
+
+namespace {
+
+    int failures = 0;
+
+    void check(bool ok, const char *what) {
+        std::printf("%s: %s\n", ok ? "ok" : "FAILED", what);
+        if (!ok)
+            failures++;
+    }
+
+    // 记录存活的副本数，检查提交失败时函数对象有没有泄漏
+    std::atomic<int> live{ 0 };
+
+    struct counted_fn {
+        counted_fn() { live++; }
+        counted_fn(const counted_fn &) { live++; }
+        counted_fn(counted_fn &&) noexcept { live++; }
+        ~counted_fn() { live--; }
+        void operator()(int) const { }
+    };
+
+    // 单线程、容量 2 的线程池: 工作线程被 gate 挡住，再放 2 个任务把队列填满
+    utils::thread::threadpool_options full_options(utils::thread::overflow_policy overflow) {
+        utils::thread::threadpool_options o;
+        o.min_threads = 1;
+        o.max_threads = 1;
+        o.capacity = 2;
+        o.overflow = overflow;
+        return o;
+    }
+
+    void fill(utils::thread::threadpool &pool, std::shared_future<void> gate) {
+        std::promise<void> started;
+        pool.post([gate, &started] { started.set_value(); gate.wait(); });
+        started.get_future().wait();
+        pool.post([] { });
+        pool.post([] { });
+    }
+
+    // reject 策略下队列已满时 commit_bulk 抛出 queue_full，不泄漏共享状态和函数对象
+    void bulk_reject() {
+        std::promise<void> open;
+        utils::thread::threadpool pool(full_options(utils::thread::overflow_policy::reject));
+        fill(pool, open.get_future().share());
+        std::vector<int> items{ 1, 2, 3 };
+        bool thrown = false;
+        try {
+            pool.commit_bulk(items.begin(), items.end(), counted_fn());
+        } catch (const utils::thread::queue_full &) {
+            thrown = true;
+        }
+        check(thrown, "commit_bulk on a full pool throws queue_full");
+        check(live == 0, "rejected commit_bulk releases its state");
+        open.set_value();
+        while (pool.taskCount() > 0)
+            std::this_thread::yield();
+        auto done = pool.commit_bulk(items.begin(), items.end(), counted_fn());
+        done.get();
+        // 最后一个任务先就绪 future 再释放共享状态，稍等它完成
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+        while (live != 0 && std::chrono::steady_clock::now() < deadline)
+            std::this_thread::yield();
+        check(live == 0, "completed commit_bulk releases its state");
+    }
+
+    // 多个生产者同时 try_post 到快满的队列: 不超过容量，也不按 caller_runs 策略在调用线程执行
+    void try_post_race() {
+        std::promise<void> open;
+        auto gate = open.get_future().share();
+        utils::thread::threadpool_options o = full_options(utils::thread::overflow_policy::caller_runs);
+        o.capacity = 4;
+        utils::thread::threadpool pool(o);
+        std::promise<void> started;
+        pool.post([gate, &started] { started.set_value(); gate.wait(); });
+        started.get_future().wait();
+        std::atomic<int> accepted{ 0 };
+        std::vector<std::thread> producers;
+        for (int p = 0; p < 4; ++p)
+            producers.emplace_back([&] {
+                for (int i = 0; i < 10000; ++i)
+                    if (pool.try_post([] { }))
+                        accepted++;
+            });
+        for (auto &t : producers)
+            t.join();
+        auto stats = pool.stats();
+        std::printf("    accepted %d, peak pending %d\n", accepted.load(), stats.peak_pending);
+        check(accepted == 4 && stats.peak_pending <= 4, "try_post never exceeds capacity");
+        check(stats.overflow.caller_runs == 0 && stats.overflow.blocked == 0, "try_post never applies the overflow policy");
+        open.set_value();
+    }
+
+}
+
+int main() {
+    bulk_reject();
+    try_post_race();
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,300 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+
+#include "task.hpp"
+#include "future.hpp"
+#include "metrics.hpp"
+
+namespace utils {
+    // 线程相关工具
+    namespace thread {
+
+#define THREADPOOL_TIMER_TICK_MS 1      // 定时器精度 (毫秒)，到期的任务最多晚一个 tick 提交
+
+        class timer_wheel;
+
+        namespace detail {
+            // 时间轮槽位中的双向链表节点，插入和删除都是 O(1)
+            struct timer_link {
+                timer_link *prev = this;
+                timer_link *next = this;
+
+                bool empty() const { return next == this; }
+
+                void push_back(timer_link *node) {
+                    node->prev = prev;
+                    node->next = this;
+                    prev->next = node;
+                    prev = node;
+                }
+
+                void unlink() {
+                    prev->next = next;
+                    next->prev = prev;
+                    prev = next = this;
+                }
+            };
+
+            struct timer_node : timer_link {
+                std::int64_t expire = 0;        // 到期 tick
+                std::int64_t period = 0;        // 周期 (tick)，0 表示只触发一次
+                int level = -1;                 // 所在层级，-1 表示不在时间轮中 (已触发或已取消)
+                std::shared_ptr<timer_node> self;   // 挂在时间轮上时由时间轮持有
+                std::weak_ptr<timer_wheel> wheel;
+                std::atomic<bool> busy{ false };    // 周期任务上一次还没执行完时跳过本次
+                task fn;
+
+                void run() {
+                    fn();
+                    busy.store(false, std::memory_order_release);
+                }
+            };
+        }  // detail
+
+        // 定时任务句柄，可复制，用于取消
+        class timer_handle
+        {
+        public:
+            timer_handle() noexcept = default;
+
+            // 取消定时任务，尚未触发时返回 true
+            // 周期任务取消后不再触发，已经提交或正在执行的那一次照常完成
+            bool cancel();
+
+            // 之后是否还会触发
+            bool pending() const;
+
+            explicit operator bool() const noexcept { return _node != nullptr; }
+
+        private:
+            friend class timer_wheel;
+            explicit timer_handle(std::shared_ptr<detail::timer_node> node) : _node(std::move(node)) { }
+
+            std::shared_ptr<detail::timer_node> _node;
+        };
+
+        // 分层时间轮: 4 层 x 256 槽，tick 为 THREADPOOL_TIMER_TICK_MS 毫秒，覆盖约 49 天 (更远的到期时间在最高层循环)
+        // 必须由 std::shared_ptr 持有，句柄通过 weak_ptr 找到时间轮
+        // 插入和取消 O(1)；由一个定时线程推进，到期的任务提交给执行器 (线程池) 执行，定时线程自己不执行任务
+        // 定时线程只在最近一个非空槽位或下一次降层时醒来，没有定时任务时一直睡眠
+        class timer_wheel : public std::enable_shared_from_this<timer_wheel>
+        {
+            static constexpr int level_count = 4;
+            static constexpr int slot_bits = 8;
+            static constexpr int slot_count = 1 << slot_bits;
+            static constexpr std::int64_t tick_ns = THREADPOOL_TIMER_TICK_MS * 1000000LL;
+
+        public:
+            explicit timer_wheel(executor exec)
+                : _exec(exec), _base(detail::now_ns()), _thread(&timer_wheel::run, this) { }
+
+            ~timer_wheel() { stop(); }
+
+            timer_wheel(const timer_wheel&) = delete;
+            timer_wheel& operator=(const timer_wheel&) = delete;
+
+            // delay 纳秒后把 fn 提交给执行器，period 大于 0 时之后每 period 纳秒提交一次
+            // 定时器按 tick 取整，不会提前触发；周期任务按固定频率触发，上一次还没执行完时跳过本次
+            timer_handle schedule(std::int64_t delay, std::int64_t period, task &&fn) {
+                auto node = std::allocate_shared<detail::timer_node>(pool_allocator<detail::timer_node>());
+                node->fn = std::move(fn);
+                node->period = period > 0 ? std::max<std::int64_t>(1, (period + tick_ns - 1) / tick_ns) : 0;
+                node->wheel = weak_from_this();
+                std::int64_t now = detail::now_ns() - _base;
+                std::int64_t deadline = now + std::max<std::int64_t>(delay, 0);
+                std::lock_guard<std::mutex> lock{ _lock };
+                if (!_run)
+                    throw std::runtime_error("schedule on stopped timer.");
+                if (_count == 0)
+                    _current = std::max(_current, now / tick_ns - 1);    // 空闲期间没有推进，直接跳到当前时间的前一个 tick
+                node->expire = std::max((deadline + tick_ns - 1) / tick_ns, _current + 1);  // 当前 tick 已经处理过
+                node->self = node;
+                link(*node);
+                if (_wake < 0 || node->expire < _wake) {
+                    _wake = node->expire;
+                    _cv.notify_one();   // 比定时线程计划醒来的时间更早
+                }
+                return timer_handle(std::move(node));
+            }
+
+            // 停止定时线程，尚未触发的定时任务全部丢弃；可重复调用
+            void stop() {
+                {
+                    std::lock_guard<std::mutex> lock{ _lock };
+                    if (!_run)
+                        return;
+                    _run = false;
+                }
+                _cv.notify_one();
+                if (_thread.joinable())
+                    _thread.join();
+                std::vector<std::shared_ptr<detail::timer_node>> dropped;
+                {
+                    std::lock_guard<std::mutex> lock{ _lock };
+                    for (auto &level : _slots)
+                        for (auto &head : level)
+                            while (!head.empty()) {
+                                auto *node = static_cast<detail::timer_node*>(head.next);
+                                dropped.push_back(unlink(*node));
+                            }
+                }
+            }
+
+            // 等待触发的定时任务数量
+            std::size_t size() {
+                std::lock_guard<std::mutex> lock{ _lock };
+                return _count;
+            }
+
+        private:
+            friend class timer_handle;
+
+            // 按到期时间与当前 tick 的距离选择层级和槽位，调用者持有 _lock
+            // 降层时 expire 可能等于 _current，放进第 0 层当前槽位，紧接着就被处理
+            void link(detail::timer_node &node) {
+                std::int64_t delta = node.expire - _current;
+                int level = 0;
+                while (level < level_count - 1 && delta >= (std::int64_t(1) << (slot_bits * (level + 1))))
+                    ++level;
+                std::int64_t slot_tick = node.expire;
+                if (delta >= (std::int64_t(1) << (slot_bits * level_count)))
+                    slot_tick = _current + (std::int64_t(255) << (slot_bits * (level_count - 1))); // 超出范围，先放在最远的槽位
+                node.level = level;
+                _slots[level][(slot_tick >> (slot_bits * level)) & (slot_count - 1)].push_back(&node);
+                _count++;
+                if (level == 0)
+                    _count0++;
+            }
+
+            // 从时间轮摘下，返回时间轮持有的引用，调用者持有 _lock
+            std::shared_ptr<detail::timer_node> unlink(detail::timer_node &node) {
+                node.unlink();
+                _count--;
+                if (node.level == 0)
+                    _count0--;
+                node.level = -1;
+                return std::move(node.self);
+            }
+
+            bool cancel(detail::timer_node &node) {
+                std::shared_ptr<detail::timer_node> keep;   // 在锁外释放
+                std::lock_guard<std::mutex> lock{ _lock };
+                if (node.level < 0)
+                    return false;
+                keep = unlink(node);
+                return true;
+            }
+
+            // 推进一个 tick: 先把高层对应槽位的定时器降层，再收集第 0 层到期的定时器
+            void advance() {
+                _current++;
+                for (int level = level_count - 1; level > 0; --level) {
+                    if (_current & ((std::int64_t(1) << (slot_bits * level)) - 1))
+                        continue;
+                    detail::timer_link &head = _slots[level][(_current >> (slot_bits * level)) & (slot_count - 1)];
+                    while (!head.empty()) {
+                        auto *node = static_cast<detail::timer_node*>(head.next);
+                        auto keep = unlink(*node);
+                        node->self = std::move(keep);
+                        link(*node);
+                    }
+                }
+                detail::timer_link &head = _slots[0][_current & (slot_count - 1)];
+                while (!head.empty()) {
+                    auto *node = static_cast<detail::timer_node*>(head.next);
+                    auto keep = unlink(*node);
+                    if (node->period > 0) {
+                        node->expire += node->period;
+                        node->self = keep;
+                        link(*node);
+                    }
+                    _due.push_back(std::move(keep));
+                }
+            }
+
+            // 定时线程下一次需要醒来的 tick，时间轮为空时返回 -1
+            std::int64_t next_tick() const {
+                if (_count == 0)
+                    return -1;
+                std::int64_t boundary = (_current | (slot_count - 1)) + 1;  // 下一次降层
+                if (_count0 > 0) {
+                    for (std::int64_t t = _current + 1; t <= _current + slot_count; ++t)
+                        if (!_slots[0][t & (slot_count - 1)].empty())
+                            return _count > _count0 ? std::min(t, boundary) : t;
+                }
+                return boundary;
+            }
+
+            void run() {
+                std::unique_lock<std::mutex> lock{ _lock };
+                while (_run) {
+                    std::int64_t now = (detail::now_ns() - _base) / tick_ns;
+                    while (_current < now && _count > 0)
+                        advance();
+                    if (_count == 0)
+                        _current = std::max(_current, now);
+                    if (!_due.empty()) {
+                        std::vector<std::shared_ptr<detail::timer_node>> due;
+                        due.swap(_due);
+                        lock.unlock();
+                        for (auto &node : due) {
+                            if (node->busy.exchange(true, std::memory_order_acq_rel))
+                                continue;   // 周期任务上一次还在执行
+                            _exec(task([node]() { node->run(); }));
+                        }
+                        due.clear();
+                        lock.lock();
+                        if (_due.empty())
+                            _due.swap(due);     // 复用容量
+                        continue;
+                    }
+                    _wake = next_tick();
+                    if (_wake < 0)
+                        _cv.wait(lock);
+                    else
+                        _cv.wait_for(lock, std::chrono::nanoseconds(_base + _wake * tick_ns - detail::now_ns()));
+                }
+            }
+
+            executor _exec;
+            const std::int64_t _base;           // tick 0 对应的单调时钟纳秒
+            std::mutex _lock;
+            std::condition_variable _cv;
+            detail::timer_link _slots[level_count][slot_count];
+            std::vector<std::shared_ptr<detail::timer_node>> _due;     // 本轮到期的定时器
+            std::int64_t _current = 0;          // 已处理到的 tick
+            std::int64_t _wake = -1;            // 定时线程计划醒来的 tick
+            std::size_t _count = 0;             // 时间轮中的定时器数量
+            std::size_t _count0 = 0;            // 其中在第 0 层的数量
+            bool _run = true;
+            std::thread _thread;                // 最后初始化，线程启动时其他成员都已构造
+        };
+
+        inline bool timer_handle::cancel() {
+            if (!_node)
+                return false;
+            if (auto wheel = _node->wheel.lock())
+                return wheel->cancel(*_node);
+            return false;
+        }
+
+        inline bool timer_handle::pending() const {
+            if (!_node)
+                return false;
+            if (auto wheel = _node->wheel.lock()) {
+                std::lock_guard<std::mutex> lock{ wheel->_lock };
+                return _node->level >= 0;
+            }
+            return false;
+        }
+
+    }  // thread
+}  // utils
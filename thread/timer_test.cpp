@@ -0,0 +1,67 @@
+// 定时任务测试，失败时返回非 0
+//     g++ -std=c++17 -O2 -I.. timer_test.cpp -o timer_test -pthread
+//     ./timer_test
+
+#include <cstdio>
+#include <cstdint>
+#include <chrono>
+#include <future>
+
+#include "threadpool.hpp"
+
+namespace {
+
+    using clock_type = std::chrono::steady_clock;
+
+    int failures = 0;
+
+    void check(bool ok, const char *what) {
+        std::printf("%s: %s\n", ok ? "ok" : "FAILED", what);
+        if (!ok)
+            failures++;
+    }
+
+    std::int64_t elapsed_ms(clock_type::time_point start, clock_type::time_point end) {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+    }
+
+    // 时间轮空闲时先放一个长定时器，再放一个短定时器: 短的先触发且按时触发
+    void long_then_short(utils::thread::threadpool &pool) {
+        std::promise<clock_type::time_point> long_fired, short_fired;
+        auto long_done = long_fired.get_future();
+        auto short_done = short_fired.get_future();
+        auto start = clock_type::now();
+        pool.commit_after(std::chrono::milliseconds(1000), [&long_fired] { long_fired.set_value(clock_type::now()); });
+        pool.commit_after(std::chrono::milliseconds(100), [&short_fired] { short_fired.set_value(clock_type::now()); });
+        auto short_at = short_done.get();
+        auto long_at = long_done.get();
+        std::int64_t s = elapsed_ms(start, short_at), l = elapsed_ms(start, long_at);
+        std::printf("    short %lld ms, long %lld ms\n", static_cast<long long>(s), static_cast<long long>(l));
+        check(short_at < long_at, "short timer fires before long timer");
+        check(s >= 100 && s < 200, "short timer fires on time");
+        check(l >= 1000 && l < 1100, "long timer fires on time");
+    }
+
+    // 时间轮空闲一段时间后再放定时器，不受空闲期间的影响
+    void after_idle(utils::thread::threadpool &pool) {
+        std::promise<void> fired;
+        pool.commit_after(std::chrono::milliseconds(1), [&fired] { fired.set_value(); });
+        fired.get_future().get();
+        std::this_thread::sleep_for(std::chrono::milliseconds(300));
+        std::promise<clock_type::time_point> again;
+        auto done = again.get_future();
+        auto start = clock_type::now();
+        pool.commit_after(std::chrono::milliseconds(50), [&again] { again.set_value(clock_type::now()); });
+        std::int64_t t = elapsed_ms(start, done.get());
+        std::printf("    %lld ms\n", static_cast<long long>(t));
+        check(t >= 50 && t < 150, "timer after idle period fires on time");
+    }
+
+}
+
+int main() {
+    utils::thread::threadpool pool(2);
+    long_then_short(pool);
+    after_idle(pool);
+    return failures == 0 ? 0 : 1;
+}
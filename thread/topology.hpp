@@ -0,0 +1,139 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <algorithm>
+#include <thread>
+#include <cstdlib>
+#include <cctype>
+
+#ifdef __linux__
+#include <sched.h>
+#include <dirent.h>
+#endif
+
+namespace utils {
+    // 线程相关工具
+    namespace thread {
+
+        // CPU 编号集合
+        using cpu_set = std::vector<int>;
+
+        namespace detail {
+            // 解析 /sys 下的 cpulist 格式，例如 "0-3,8-11,16"
+            inline cpu_set parse_cpulist(const std::string &text) {
+                cpu_set cpus;
+                const char *p = text.c_str();
+                while (*p) {
+                    if (!std::isdigit(static_cast<unsigned char>(*p))) {
+                        ++p;
+                        continue;
+                    }
+                    char *end;
+                    int first = static_cast<int>(std::strtol(p, &end, 10));
+                    int last = first;
+                    if (*end == '-')
+                        last = static_cast<int>(std::strtol(end + 1, &end, 10));
+                    for (int cpu = first; cpu <= last; ++cpu)
+                        cpus.push_back(cpu);
+                    p = end;
+                }
+                return cpus;
+            }
+
+            // 当前进程允许运行的 CPU (受 taskset/cgroup 限制)
+            inline cpu_set allowed_cpus() {
+                cpu_set cpus;
+#ifdef __linux__
+                ::cpu_set_t mask;
+                CPU_ZERO(&mask);
+                if (::sched_getaffinity(0, sizeof(mask), &mask) == 0) {
+                    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+                        if (CPU_ISSET(cpu, &mask))
+                            cpus.push_back(cpu);
+                }
+#endif
+                if (cpus.empty()) {
+                    for (unsigned cpu = 0; cpu < std::max(1u, std::thread::hardware_concurrency()); ++cpu)
+                        cpus.push_back(static_cast<int>(cpu));
+                }
+                return cpus;
+            }
+
+            // 把调用线程绑定到指定 CPU，失败 (容器限制、非 Linux) 时返回 false，线程照常运行
+            inline bool set_affinity(const cpu_set &cpus) {
+#ifdef __linux__
+                ::cpu_set_t mask;
+                CPU_ZERO(&mask);
+                for (int cpu : cpus)
+                    if (cpu >= 0 && cpu < CPU_SETSIZE)
+                        CPU_SET(cpu, &mask);
+                return CPU_COUNT(&mask) > 0 && ::sched_setaffinity(0, sizeof(mask), &mask) == 0;
+#else
+                (void)cpus;
+                return false;
+#endif
+            }
+        }  // detail
+
+        // NUMA 拓扑，从 /sys/devices/system/node 读取
+        // 只保留当前进程允许使用的 CPU，没有可用 CPU 的节点 (纯内存节点) 被忽略；读不到时当作一个节点
+        struct numa_topology
+        {
+            struct node {
+                int id;         // 内核中的节点编号，可能不连续
+                cpu_set cpus;
+            };
+            std::vector<node> nodes;
+
+            static numa_topology detect() {
+                numa_topology topo;
+                cpu_set allowed = detail::allowed_cpus();
+#ifdef __linux__
+                const std::string root = "/sys/devices/system/node";
+                if (DIR *dir = ::opendir(root.c_str())) {
+                    while (dirent *entry = ::readdir(dir)) {
+                        std::string name = entry->d_name;
+                        if (name.size() < 5 || name.compare(0, 4, "node") != 0
+                            || !std::all_of(name.begin() + 4, name.end(), [](char c) { return std::isdigit(static_cast<unsigned char>(c)); }))
+                            continue;
+                        std::ifstream in(root + "/" + name + "/cpulist");
+                        std::string text;
+                        if (!std::getline(in, text))
+                            continue;
+                        cpu_set cpus;
+                        for (int cpu : detail::parse_cpulist(text))
+                            if (std::find(allowed.begin(), allowed.end(), cpu) != allowed.end())
+                                cpus.push_back(cpu);
+                        if (!cpus.empty())
+                            topo.nodes.push_back(node{ std::atoi(name.c_str() + 4), std::move(cpus) });
+                    }
+                    ::closedir(dir);
+                }
+#endif
+                if (topo.nodes.empty())
+                    topo.nodes.push_back(node{ 0, std::move(allowed) });
+                std::sort(topo.nodes.begin(), topo.nodes.end(), [](const node &a, const node &b) { return a.id < b.id; });
+                return topo;
+            }
+
+            // CPU 所在节点在 nodes 中的下标，找不到返回 -1
+            int index_of_cpu(int cpu) const {
+                for (std::size_t i = 0; i < nodes.size(); ++i)
+                    if (std::find(nodes[i].cpus.begin(), nodes[i].cpus.end(), cpu) != nodes[i].cpus.end())
+                        return static_cast<int>(i);
+                return -1;
+            }
+
+            // 节点编号在 nodes 中的下标，找不到返回 -1
+            int index_of_node(int id) const {
+                for (std::size_t i = 0; i < nodes.size(); ++i)
+                    if (nodes[i].id == id)
+                        return static_cast<int>(i);
+                return -1;
+            }
+        };
+
+    }  // thread
+}  // utils